@@ -0,0 +1,315 @@
+
+// Headless strong- and weak-scaling benchmark of the domain-decomposed Jacobi
+// pressure sweep. Every rank is a forked process owning one Subdomain.
+//
+//  usage: decomposition_bench [-n strong_size] [-w weak_size] [-i sweeps]
+//                             [-p max_ranks] [-t shm|socket]
+//                             [-r residual_interval] [-o instrumentation_prefix]
+//
+// With -o, and built with FIELD_INSTRUMENTATION, every rank of every run writes
+// <prefix>_<run>_rank<r>_{trace.json,kernels.csv,residuals.csv,summary.txt}.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
+#include <algorithm>
+
+#include "src/domain_decomposition.h"
+#include "src/instrumentation.h"
+
+
+struct bench_result_t
+{
+    double seconds;
+    float residual;
+};
+
+//
+struct bench_config_t
+{
+    TransportType type      = TransportType::SharedMemory;
+    int sweeps              = 200;
+    int residual_interval   = 0;        // 0: only after the last sweep
+    const char *out_prefix  = nullptr;
+    const char *run_name    = "";
+};
+
+//
+static double now_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+static void run_rank(const DomainDecomposition &_decomp,
+                     std::shared_ptr<HaloTransport> _transport,
+                     int _rank,
+                     const bench_config_t &_cfg,
+                     int _result_fd)
+{
+    _transport->bind(_rank);
+    Instrumentation::get().reset();
+
+    const glm::ivec2 shape = _decomp.globalShape();
+    const float h = 1.0f / (float)shape.y;
+    Subdomain sd(_decomp, _rank, _transport, h);
+
+    // a pair of opposite gaussian sources
+    const subdomain_box_t &b = sd.box();
+    float *rhs = sd.rhs()->data();
+    const glm::vec2 c0 = { 0.35f * shape.x, 0.5f * shape.y };
+    const glm::vec2 c1 = { 0.65f * shape.x, 0.5f * shape.y };
+    const float inv_r2 = 1.0f / (0.01f * shape.x * shape.x);
+    for (int y = 0; y < b.shape.y; y++)
+    {
+        for (int x = 0; x < b.shape.x; x++)
+        {
+            const glm::vec2 p = { (float)(b.origin.x + x), (float)(b.origin.y + y) };
+            const glm::vec2 d0 = p - c0;
+            const glm::vec2 d1 = p - c1;
+            rhs[sd.idx(x, y)] = expf(-glm::dot(d0, d0) * inv_r2) - expf(-glm::dot(d1, d1) * inv_r2);
+        }
+    }
+
+    _transport->allreduceSum(0.0);  // barrier
+    const double t0 = now_s();
+    for (int i = 0; i < _cfg.sweeps; i++)
+    {
+        sd.jacobi();
+        if (_cfg.residual_interval > 0 && (i + 1) % _cfg.residual_interval == 0 && i + 1 < _cfg.sweeps)
+            sd.residual();
+    }
+    const float res = sd.residual();    // also synchronizes the ranks
+    const double t1 = now_s();
+
+    #ifdef FIELD_INSTRUMENTATION
+    if (_cfg.out_prefix)
+    {
+        char path[512];
+        const Instrumentation &instr = Instrumentation::get();
+        snprintf(path, sizeof(path), "%s_%s_rank%d_trace.json", _cfg.out_prefix, _cfg.run_name, _rank);
+        instr.writeChromeTrace(path);
+        snprintf(path, sizeof(path), "%s_%s_rank%d_kernels.csv", _cfg.out_prefix, _cfg.run_name, _rank);
+        instr.writeSummaryCsv(path);
+        snprintf(path, sizeof(path), "%s_%s_rank%d_residuals.csv", _cfg.out_prefix, _cfg.run_name, _rank);
+        instr.writeResidualCsv(path);
+        snprintf(path, sizeof(path), "%s_%s_rank%d_summary.txt", _cfg.out_prefix, _cfg.run_name, _rank);
+        if (FILE *fp = fopen(path, "w"))
+        {
+            instr.printSummary(fp);
+            fclose(fp);
+        }
+    }
+    #endif
+
+    if (_rank == 0)
+    {
+        bench_result_t r = { t1 - t0, res };
+        if (write(_result_fd, &r, sizeof(r)) != sizeof(r))
+            perror("write");
+    }
+}
+
+// Returns false if any rank failed or rank 0 reported no result; _result is
+// only valid on success.
+static bool run(const glm::ivec2 &_shape, const glm::ivec2 &_ranks, const bench_config_t &_cfg, bench_result_t &_result)
+{
+    DomainDecomposition decomp(_shape, _ranks);
+    std::shared_ptr<HaloTransport> transport = HaloTransport::create(_cfg.type, decomp);
+
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<pid_t> pids;
+    for (int r = 0; r < decomp.rankCount(); r++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            close(fds[0]);
+            run_rank(decomp, transport, r, _cfg, fds[1]);
+            _exit(0);
+        }
+        pids.push_back(pid);
+    }
+    close(fds[1]);
+    transport->bind(-1);
+
+    // reap every rank before reading the result, so that a dead rank cannot
+    // leave the parent blocked on the pipe; the others are told to give up
+    bool failed = false;
+    for (size_t i = 0; i < pids.size(); i++)
+    {
+        int status;
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            perror("waitpid");
+            break;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "rank process %d failed\n", (int)pid);
+            if (!failed)
+                transport->abort();
+            failed = true;
+        }
+    }
+
+    const bool received = (read(fds[0], &_result, sizeof(_result)) == (ssize_t)sizeof(_result));
+    if (!received)
+        fprintf(stderr, "no result from rank 0\n");
+    close(fds[0]);
+
+    return received && !failed;
+}
+
+//
+static void print_header(const char *_title)
+{
+    printf("\n%s\n", _title);
+    printf("%6s %8s %12s %12s %10s %10s %8s %8s %12s\n",
+           "ranks", "grid", "global", "subdomain", "time[s]", "Mcell/s", "speedup", "eff", "residual");
+}
+
+//
+// _t1 <= 0: no single-rank baseline, speedup and efficiency are not printed.
+static void print_row(int _n, const DomainDecomposition &_decomp, const bench_result_t &_r, int _sweeps,
+                      double _t1, bool _weak)
+{
+    const glm::ivec2 g = _decomp.globalShape();
+    const subdomain_box_t b = _decomp.box(0);
+    const double cells = (double)g.x * g.y * _sweeps;
+    char grid[32], global[32], sub[32], speedup[16] = "-", eff[16] = "-";
+    snprintf(grid, sizeof(grid), "%dx%d", _decomp.ranks().x, _decomp.ranks().y);
+    snprintf(global, sizeof(global), "%dx%d", g.x, g.y);
+    snprintf(sub, sizeof(sub), "%dx%d", b.shape.x, b.shape.y);
+    if (_t1 > 0.0)
+    {
+        // weak scaling: ideal time is constant, speedup is scaled by the work
+        const double s = _weak ? _n * _t1 / _r.seconds : _t1 / _r.seconds;
+        snprintf(speedup, sizeof(speedup), "%.2f", s);
+        snprintf(eff, sizeof(eff), "%.2f", s / _n);
+    }
+    printf("%6d %8s %12s %12s %10.4f %10.1f %8s %8s %12.4e\n",
+           _n, grid, global, sub, _r.seconds, cells / _r.seconds * 1e-6, speedup, eff, _r.residual);
+}
+
+//
+static void print_failed_row(int _n, const DomainDecomposition &_decomp)
+{
+    char grid[32];
+    snprintf(grid, sizeof(grid), "%dx%d", _decomp.ranks().x, _decomp.ranks().y);
+    printf("%6d %8s   failed\n", _n, grid);
+}
+
+//
+int main(int argc, char **argv)
+{
+    int strong_n = 2048;
+    int weak_n = 1024;
+    int max_ranks = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    bench_config_t cfg;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_arg = i + 1 < argc;
+        if      (!strcmp(argv[i], "-n") && has_arg) strong_n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && has_arg) weak_n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-i") && has_arg) cfg.sweeps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p") && has_arg) max_ranks = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && has_arg) cfg.residual_interval = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && has_arg) cfg.out_prefix = argv[++i];
+        else if (!strcmp(argv[i], "-t") && has_arg)
+        {
+            ++i;
+            if      (!strcmp(argv[i], "shm"))       cfg.type = TransportType::SharedMemory;
+            else if (!strcmp(argv[i], "socket"))    cfg.type = TransportType::UnixSocket;
+            else { fprintf(stderr, "unknown transport '%s'\n", argv[i]); return EXIT_FAILURE; }
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n strong_size] [-w weak_size] [-i sweeps] [-p max_ranks] [-t shm|socket] "
+                            "[-r residual_interval] [-o instrumentation_prefix]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    max_ranks = std::max(max_ranks, 1);
+    #ifndef FIELD_INSTRUMENTATION
+    if (cfg.out_prefix)
+        fprintf(stderr, "built without FIELD_INSTRUMENTATION, -o ignored\n");
+    #endif
+
+    std::vector<int> rank_counts;
+    for (int n = 1; n <= max_ranks; n *= 2)
+        rank_counts.push_back(n);
+    if (rank_counts.back() != max_ranks)
+        rank_counts.push_back(max_ranks);
+
+    const char *transport_name = (cfg.type == TransportType::SharedMemory ? "shm" : "socket");
+    char title[128];
+    char run_name[32];
+    cfg.run_name = run_name;
+
+    // strong scaling: fixed global grid
+    snprintf(title, sizeof(title), "strong scaling, %d x %d, %d sweeps, %s transport", strong_n, strong_n, cfg.sweeps, transport_name);
+    print_header(title);
+    bool failed = false;
+    double t1 = 0.0;
+    for (int n : rank_counts)
+    {
+        const glm::ivec2 shape = { strong_n, strong_n };
+        DomainDecomposition decomp(shape, DomainDecomposition::factor(n, shape));
+        snprintf(run_name, sizeof(run_name), "strong%d", n);
+        bench_result_t r;
+        if (!run(shape, decomp.ranks(), cfg, r))
+        {
+            print_failed_row(n, decomp);
+            failed = true;
+            continue;
+        }
+        if (n == 1) t1 = r.seconds;
+        print_row(n, decomp, r, cfg.sweeps, t1, false);
+    }
+
+    // weak scaling: fixed subdomain per rank
+    snprintf(title, sizeof(title), "weak scaling, %d x %d per rank, %d sweeps, %s transport", weak_n, weak_n, cfg.sweeps, transport_name);
+    print_header(title);
+    t1 = 0.0;
+    for (int n : rank_counts)
+    {
+        const glm::ivec2 ranks = DomainDecomposition::factor(n, { 1, 1 });
+        const glm::ivec2 shape = { ranks.x * weak_n, ranks.y * weak_n };
+        DomainDecomposition decomp(shape, ranks);
+        snprintf(run_name, sizeof(run_name), "weak%d", n);
+        bench_result_t r;
+        if (!run(shape, ranks, cfg, r))
+        {
+            print_failed_row(n, decomp);
+            failed = true;
+            continue;
+        }
+        if (n == 1) t1 = r.seconds;
+        print_row(n, decomp, r, cfg.sweeps, t1, true);
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
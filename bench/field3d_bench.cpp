@@ -0,0 +1,211 @@
+
+// Headless benchmark of the blocked 3D kernels against a straightforward
+// triple-loop reference: checks that both agree and reports ms per sweep and the
+// effective bandwidth (compulsory traffic: every input read and every output
+// written once).
+//
+//  usage: field3d_bench [-n size] [-i sweeps]
+//
+// The y blocking can be tuned at build time with -DFIELD3D_BLOCK_Y=<rows>.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#include "src/field3d.h"
+
+
+//
+static double now_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Reference value at (x, y, z), clamped to the edge or zero outside the domain.
+template<typename T>
+static __always_inline T at(const T *_f, const glm::ivec3 &_s, int _x, int _y, int _z, bool _zero)
+{
+    if (_x < 0 || _y < 0 || _z < 0 || _x >= _s.x || _y >= _s.y || _z >= _s.z)
+    {
+        if (_zero)
+            return T(0);
+        _x = std::min(std::max(_x, 0), _s.x - 1);
+        _y = std::min(std::max(_y, 0), _s.y - 1);
+        _z = std::min(std::max(_z, 0), _s.z - 1);
+    }
+    return _f[field3d_idx(_s, _x, _y, _z)];
+}
+
+//
+static void ref_gradient(const float *_f, glm::vec3 *_g, const glm::ivec3 &_s, float _h)
+{
+    const float inv_2h = 1.0f / (2.0f * _h);
+    for (int z = 0; z < _s.z; z++)
+        for (int y = 0; y < _s.y; y++)
+            for (int x = 0; x < _s.x; x++)
+                _g[field3d_idx(_s, x, y, z)] = { (at(_f, _s, x + 1, y, z, false) - at(_f, _s, x - 1, y, z, false)) * inv_2h,
+                                                 (at(_f, _s, x, y + 1, z, false) - at(_f, _s, x, y - 1, z, false)) * inv_2h,
+                                                 (at(_f, _s, x, y, z + 1, false) - at(_f, _s, x, y, z - 1, false)) * inv_2h };
+}
+
+//
+static void ref_divergence(const glm::vec3 *_v, float *_d, const glm::ivec3 &_s, float _h)
+{
+    const float inv_2h = 1.0f / (2.0f * _h);
+    for (int z = 0; z < _s.z; z++)
+        for (int y = 0; y < _s.y; y++)
+            for (int x = 0; x < _s.x; x++)
+                _d[field3d_idx(_s, x, y, z)] = inv_2h * (at(_v, _s, x + 1, y, z, false).x - at(_v, _s, x - 1, y, z, false).x +
+                                                         at(_v, _s, x, y + 1, z, false).y - at(_v, _s, x, y - 1, z, false).y +
+                                                         at(_v, _s, x, y, z + 1, false).z - at(_v, _s, x, y, z - 1, false).z);
+}
+
+//
+static void ref_jacobi(const float *_p, const float *_rhs, float *_out, const glm::ivec3 &_s, float _h)
+{
+    const float h2 = _h * _h;
+    const float inv_6 = 1.0f / 6.0f;
+    for (int z = 0; z < _s.z; z++)
+        for (int y = 0; y < _s.y; y++)
+            for (int x = 0; x < _s.x; x++)
+            {
+                const size_t i = field3d_idx(_s, x, y, z);
+                _out[i] = inv_6 * (at(_p, _s, x - 1, y, z, true) + at(_p, _s, x + 1, y, z, true) +
+                                   at(_p, _s, x, y - 1, z, true) + at(_p, _s, x, y + 1, z, true) +
+                                   at(_p, _s, x, y, z - 1, true) + at(_p, _s, x, y, z + 1, true) - h2 * _rhs[i]);
+            }
+}
+
+//
+static float ref_residual(const float *_p, const float *_rhs, const glm::ivec3 &_s, float _h)
+{
+    const float inv_h2 = 1.0f / (_h * _h);
+    double sum = 0.0;
+    for (int z = 0; z < _s.z; z++)
+        for (int y = 0; y < _s.y; y++)
+            for (int x = 0; x < _s.x; x++)
+            {
+                const size_t i = field3d_idx(_s, x, y, z);
+                const float lap = inv_h2 * (at(_p, _s, x - 1, y, z, true) + at(_p, _s, x + 1, y, z, true) +
+                                            at(_p, _s, x, y - 1, z, true) + at(_p, _s, x, y + 1, z, true) +
+                                            at(_p, _s, x, y, z - 1, true) + at(_p, _s, x, y, z + 1, true) - 6.0f * _p[i]);
+                const float r = lap - _rhs[i];
+                sum += (double)r * r;
+            }
+    return (float)sqrt(sum);
+}
+
+//
+static float max_diff(const float *_a, const float *_b, size_t _n)
+{
+    float d = 0.0f;
+    for (size_t i = 0; i < _n; i++)
+        d = std::max(d, fabsf(_a[i] - _b[i]));
+    return d;
+}
+
+//
+static void print_row(const char *_name, double _ms, double _ref_ms, double _bytes, float _err)
+{
+    printf("%-14s %12.3f %12.3f %8.2f %10.2f %10.2f %12.3e\n",
+           _name, _ms, _ref_ms, _ref_ms / _ms, _bytes / (_ms * 1e-3) * 1e-9, _bytes / (_ref_ms * 1e-3) * 1e-9, _err);
+}
+
+//
+int main(int argc, char **argv)
+{
+    int size = 256;
+    int sweeps = 10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_arg = i + 1 < argc;
+        if      (!strcmp(argv[i], "-n") && has_arg) size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-i") && has_arg) sweeps = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n size] [-i sweeps]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    size = std::max(size, 2);
+    sweeps = std::max(sweeps, 1);
+
+    const glm::ivec3 shape = { size, size, size };
+    const size_t n = (size_t)size * size * size;
+    const float h = 1.0f / (float)size;
+
+    Field1D f(shape), rhs(shape), scalar(shape);
+    Field3D grad(shape), grad_ref(shape);
+
+    float *pf = f.data();
+    float *pr = rhs.data();
+    for (int z = 0; z < size; z++)
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++)
+            {
+                const size_t i = field3d_idx(shape, x, y, z);
+                pf[i] = sinf(0.05f * x) * cosf(0.07f * y) + 0.5f * sinf(0.03f * z + 0.01f * x * y * h);
+                pr[i] = cosf(0.11f * x - 0.05f * z) * sinf(0.09f * y);
+            }
+
+    printf("\n%d^3, %d sweeps, FIELD3D_BLOCK_Y %d\n", size, sweeps, FIELD3D_BLOCK_Y);
+    printf("%-14s %12s %12s %8s %10s %10s %12s\n", "kernel", "ms/sweep", "ref ms", "speedup", "GB/s", "ref GB/s", "max_diff");
+
+    double t0, ms, ref_ms;
+
+    // gradient
+    gradient3d(&f, &grad, shape, h);
+    ref_gradient(pf, grad_ref.data(), shape, h);
+    const float err_grad = max_diff((const float *)grad.data(), (const float *)grad_ref.data(), 3 * n);
+    t0 = now_s();
+    for (int i = 0; i < sweeps; i++) gradient3d(&f, &grad, shape, h);
+    ms = (now_s() - t0) * 1e3 / sweeps;
+    t0 = now_s();
+    for (int i = 0; i < sweeps; i++) ref_gradient(pf, grad_ref.data(), shape, h);
+    ref_ms = (now_s() - t0) * 1e3 / sweeps;
+    print_row("gradient3d", ms, ref_ms, n * 16.0, err_grad);
+
+    // divergence
+    divergence3d(&grad, &scalar, shape, h);
+    ref_divergence(grad.data(), scalar.backBuffer(), shape, h);
+    const float err_div = max_diff(scalar.data(), scalar.backBuffer(), n);
+    t0 = now_s();
+    for (int i = 0; i < sweeps; i++) divergence3d(&grad, &scalar, shape, h);
+    ms = (now_s() - t0) * 1e3 / sweeps;
+    t0 = now_s();
+    for (int i = 0; i < sweeps; i++) ref_divergence(grad.data(), scalar.backBuffer(), shape, h);
+    ref_ms = (now_s() - t0) * 1e3 / sweeps;
+    print_row("divergence3d", ms, ref_ms, n * 16.0, err_div);
+
+    // jacobi: reference sweep of the same input into the scratch field
+    ref_jacobi(pf, pr, scalar.data(), shape, h);
+    jacobi3d(&f, &rhs, shape, h);
+    const float err_jac = max_diff(f.data(), scalar.data(), n);
+    t0 = now_s();
+    for (int i = 0; i < sweeps; i++) jacobi3d(&f, &rhs, shape, h);
+    ms = (now_s() - t0) * 1e3 / sweeps;
+    t0 = now_s();
+    for (int i = 0; i < sweeps; i++) { ref_jacobi(f.data(), pr, scalar.data(), shape, h); }
+    ref_ms = (now_s() - t0) * 1e3 / sweeps;
+    print_row("jacobi3d", ms, ref_ms, n * 12.0, err_jac);
+
+    // residual
+    float r = 0.0f, r_ref = 0.0f;
+    t0 = now_s();
+    for (int i = 0; i < sweeps; i++) r = residual3d(&f, &rhs, shape, h);
+    ms = (now_s() - t0) * 1e3 / sweeps;
+    t0 = now_s();
+    for (int i = 0; i < sweeps; i++) r_ref = ref_residual(f.data(), pr, shape, h);
+    ref_ms = (now_s() - t0) * 1e3 / sweeps;
+    print_row("residual3d", ms, ref_ms, n * 8.0, fabsf(r - r_ref) / std::max(r_ref, 1e-30f));
+
+    return EXIT_SUCCESS;
+}
+
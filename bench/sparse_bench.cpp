@@ -0,0 +1,249 @@
+
+// Headless benchmark of the brick-sparse field on a localized plume. Reports the
+// active bricks and memory against a dense field of the same size, the
+// reconstruction error, whether updateActivity() is stable on the refined field,
+// how the active set follows a plume that moves across the domain, and
+// per-sweep kernel times against a fully active field.
+//
+//  usage: sparse_bench [-n min_size] [-m max_size] [-d max_dense_size]
+//                      [-i sweeps] [-e threshold] [-s moving_steps]
+//
+// Memory is reported for every power-of-two size in [min_size, max_size]; the
+// fully active baseline and the dense reconstruction are only built up to
+// max_dense_size.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#include "src/sparse_field.h"
+
+
+//
+static double now_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// A narrow rising jet with a mushroom cap, occupying a few percent of the
+// domain, centred at _cx (fraction of the domain width).
+static float plume(int _x, int _y, int _n, float _cx=0.5f)
+{
+    const float u = (float)_x / (float)_n - _cx;
+    const float v = (float)_y / (float)_n;
+    const float stem = expf(-u * u / 0.0005f) * (v > 0.05f && v < 0.55f ? 1.0f : 0.0f);
+    const float du = fabsf(u) - 0.06f;
+    const float dv = v - 0.6f;
+    const float cap = expf(-(du * du + dv * dv) / 0.002f);
+    return std::max(stem, cap);
+}
+
+// Active bricks whose cells are all within _threshold of their midrange, i.e.
+// that hold nothing a quadtree leaf could not.
+static uint32_t flat_bricks(const SparseField1D &_f, float _threshold)
+{
+    uint32_t n = 0;
+    for (int32_t idx : _f.activeBricks())
+    {
+        const brick_t<float> *b = _f.brick(idx);
+        const glm::ivec2 ext = _f.extent(b->id);
+        float lo = b->data()[0], hi = lo;
+        for (int ly = 0; ly < ext.y; ly++)
+            for (int lx = 0; lx < ext.x; lx++)
+            {
+                lo = std::min(lo, b->data()[ly * BRICK_DIM + lx]);
+                hi = std::max(hi, b->data()[ly * BRICK_DIM + lx]);
+            }
+        n += ((hi - lo) * 0.5f <= _threshold ? 1 : 0);
+    }
+    return n;
+}
+
+// Moves the plume from 0.2 to 0.8 of the width in _steps steps. Every step
+// stands in for a solver update: active bricks take the new field, cells it
+// has reached outside them are set, then updateActivity() adjusts the active
+// set. A fresh refine at the same position is the reference.
+static void moving_source(int _n, int _steps, float _threshold)
+{
+    printf("\nmoving plume, %d x %d, threshold %g\n", _n, _n, _threshold);
+    printf("%6s %8s %10s %10s %10s %8s %8s\n", "step", "x", "active", "flat", "refined", "ratio", "stable");
+
+    const glm::ivec2 shape = { _n, _n };
+    SparseField1D f(shape);
+    f.refine([_n](int _x, int _y) { return plume(_x, _y, _n, 0.2f); }, _threshold);
+
+    for (int s = 1; s <= _steps; s++)
+    {
+        const float cx = 0.2f + 0.6f * s / _steps;
+        auto sample = [_n, cx](int _x, int _y) { return plume(_x, _y, _n, cx); };
+
+        for (int32_t idx : f.activeBricks())
+        {
+            brick_t<float> *b = f.brick(idx);
+            const glm::ivec2 ext = f.extent(b->id);
+            for (int ly = 0; ly < ext.y; ly++)
+                for (int lx = 0; lx < ext.x; lx++)
+                    b->data()[ly * BRICK_DIM + lx] = sample(b->id.x * BRICK_DIM + lx, b->id.y * BRICK_DIM + ly);
+        }
+        for (int y = 0; y < _n; y++)
+            for (int x = 0; x < _n; x++)
+            {
+                const float v = sample(x, y);
+                if (fabsf(v - f.get(x, y)) > _threshold)
+                    f.set(x, y, v);
+            }
+        f.updateActivity(_threshold);
+
+        const uint32_t active = f.activeBrickCount();
+        SparseField1D ref(shape);
+        ref.refine(sample, _threshold);
+
+        char stable[32] = "yes";
+        f.updateActivity(_threshold);
+        if (f.activeBrickCount() != active)
+            snprintf(stable, sizeof(stable), "%u->%u", active, f.activeBrickCount());
+
+        printf("%6d %8.3f %10u %10u %10u %8.2f %8s\n",
+               s, cx, active, flat_bricks(f, _threshold), ref.activeBrickCount(),
+               (double)active / std::max(ref.activeBrickCount(), 1u), stable);
+    }
+}
+
+//
+struct sweep_times_t
+{
+    double gradient;
+    double divergence;
+    double jacobi;
+};
+
+// Average ms per call of each kernel over _sweeps calls, on _p's active set.
+static sweep_times_t time_sweeps(SparseField1D &_p, SparseField1D &_rhs, int _sweeps, float _h)
+{
+    SparseField2D grad(_p.shape());
+    SparseField1D div(_p.shape());
+    sweep_times_t t;
+
+    double t0 = now_s();
+    for (int i = 0; i < _sweeps; i++)
+        sparse_gradient(_p, grad, _h);
+    t.gradient = (now_s() - t0) * 1e3 / _sweeps;
+
+    t0 = now_s();
+    for (int i = 0; i < _sweeps; i++)
+        sparse_divergence(grad, div, _h);
+    t.divergence = (now_s() - t0) * 1e3 / _sweeps;
+
+    t0 = now_s();
+    for (int i = 0; i < _sweeps; i++)
+        sparse_jacobi(_p, _rhs, _h, 0.0f);
+    t.jacobi = (now_s() - t0) * 1e3 / _sweeps;
+
+    return t;
+}
+
+//
+int main(int argc, char **argv)
+{
+    int min_n = 1024;
+    int max_n = 8192;
+    int max_dense_n = 2048;
+    int sweeps = 20;
+    float threshold = 1e-3f;
+    int moving_steps = 12;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_arg = i + 1 < argc;
+        if      (!strcmp(argv[i], "-n") && has_arg) min_n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && has_arg) max_n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && has_arg) max_dense_n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-i") && has_arg) sweeps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-e") && has_arg) threshold = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && has_arg) moving_steps = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n min_size] [-m max_size] [-d max_dense_size] [-i sweeps] [-e threshold] [-s moving_steps]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    min_n = std::max(min_n, BRICK_DIM);
+    sweeps = std::max(sweeps, 1);
+
+    printf("\nmemory, plume, threshold %g\n", threshold);
+    printf("%8s %10s %10s %8s %12s %12s %8s %12s %10s\n",
+           "size", "bricks", "active", "nodes", "sparse[MB]", "dense[MB]", "ratio", "max_err", "stable");
+    for (int n = min_n; n <= max_n; n *= 2)
+    {
+        const glm::ivec2 shape = { n, n };
+        SparseField1D f(shape);
+        f.refine([n](int _x, int _y) { return plume(_x, _y, n); }, threshold);
+
+        // both buffers of a dense Field1D
+        const double dense_bytes = 2.0 * n * n * sizeof(float);
+        const uint32_t total = (uint32_t)(f.bricksShape().x * f.bricksShape().y);
+        const uint32_t active = f.activeBrickCount();
+
+        char err[32] = "-";
+        if (n <= max_dense_n)
+        {
+            Field1D dense(shape);
+            f.toDense(&dense);
+            const float *p = dense.data();
+            float max_err = 0.0f;
+            for (int y = 0; y < n; y++)
+                for (int x = 0; x < n; x++)
+                    max_err = std::max(max_err, fabsf(p[y * n + x] - plume(x, y, n)));
+            snprintf(err, sizeof(err), "%.3e", max_err);
+        }
+
+        f.updateActivity(threshold);
+        char stable[32];
+        snprintf(stable, sizeof(stable), "%s", f.activeBrickCount() == active ? "yes" : "no");
+        if (f.activeBrickCount() != active)
+            snprintf(stable, sizeof(stable), "%u->%u", active, f.activeBrickCount());
+
+        printf("%8d %10u %9.2f%% %8u %12.2f %12.2f %8.3f %12s %10s\n",
+               n, total, 100.0 * active / total, f.nodeCount(), f.size_bytes() / 1048576.0,
+               dense_bytes / 1048576.0, f.size_bytes() / dense_bytes, err, stable);
+    }
+
+    if (moving_steps > 0)
+        moving_source(min_n, moving_steps, threshold);
+
+    printf("\nkernels, %d sweeps, ms per sweep (sparse / fully active)\n", sweeps);
+    printf("%8s %20s %20s %20s\n", "size", "gradient", "divergence", "jacobi");
+    for (int n = min_n; n <= std::min(max_n, max_dense_n); n *= 2)
+    {
+        const glm::ivec2 shape = { n, n };
+        const float h = 1.0f / (float)n;
+        auto sample = [n](int _x, int _y) { return plume(_x, _y, n); };
+
+        SparseField1D rhs(shape);
+        rhs.refine(sample, threshold);
+
+        SparseField1D p(shape);
+        p.refine(sample, threshold);
+        const sweep_times_t ts = time_sweeps(p, rhs, sweeps, h);
+
+        // every brick allocated
+        SparseField1D p_full(shape);
+        p_full.refine(sample, -1.0f);
+        const sweep_times_t tf = time_sweeps(p_full, rhs, sweeps, h);
+
+        char g[32], d[32], j[32];
+        snprintf(g, sizeof(g), "%.3f / %.3f", ts.gradient, tf.gradient);
+        snprintf(d, sizeof(d), "%.3f / %.3f", ts.divergence, tf.divergence);
+        snprintf(j, sizeof(j), "%.3f / %.3f", ts.jacobi, tf.jacobi);
+        printf("%8d %20s %20s %20s\n", n, g, d, j);
+    }
+
+    return EXIT_SUCCESS;
+}
+
@@ -1,3 +1,9 @@
+newoption
+{
+    trigger = "instrument",
+    description = "Enable per-kernel timers, counters and trace export",
+}
+
 workspace "syn_app"
     -- location of generated solution/make and build files
     location "build"
@@ -32,6 +38,10 @@ workspace "syn_app"
         --optimize "On" --> -O2
         optimize "Speed" -- --> -O3
 
+    -- compile in the field / solver instrumentation (src/instrumentation.h)
+    filter "options:instrument"
+        defines { "FIELD_INSTRUMENTATION" }
+
     -- reset filter
     filter { }
 
@@ -84,6 +94,7 @@ project "pressure_solver"
         "dl",           -- dep of glfw
         "X11",          -- dep of glfw (Linux only)
         "atomic",
+        "rt",           -- shm_open (halo transport)
         -- "synapse-dev",
         "synapse",
     }
@@ -94,3 +105,103 @@ project "pressure_solver"
     filter { "configurations.Release" }
         runtime "Release"
 
+
+-----------------------------------------------------------------------------------------
+-- headless scaling benchmark of the domain-decomposed solver, no synapse dependency
+project "decomposition_bench"
+
+    kind "ConsoleApp"
+
+    targetdir ("%{wks.location}")
+	objdir ("%{wks.location}/obj")
+
+    files
+    {
+        "bench/decomposition_bench.cpp",
+        "src/domain_decomposition.cpp",
+        "src/domain_decomposition.h",
+        "src/halo_transport.cpp",
+        "src/halo_transport.h",
+        "src/instrumentation.cpp",
+        "src/instrumentation.h",
+        "src/field.h",
+    }
+
+    includedirs
+    {
+        ".",
+    }
+
+    links
+    {
+        "pthread",
+        "rt",
+    }
+
+    filter { "configurations.Debug" }
+        runtime "Debug"
+
+    filter { "configurations.Release" }
+        runtime "Release"
+
+
+-----------------------------------------------------------------------------------------
+-- headless memory and kernel benchmark of the brick-sparse field
+project "sparse_bench"
+
+    kind "ConsoleApp"
+
+    targetdir ("%{wks.location}")
+	objdir ("%{wks.location}/obj")
+
+    files
+    {
+        "bench/sparse_bench.cpp",
+        "src/instrumentation.cpp",
+        "src/instrumentation.h",
+        "src/sparse_field.h",
+        "src/field.h",
+    }
+
+    includedirs
+    {
+        ".",
+    }
+
+    filter { "configurations.Debug" }
+        runtime "Debug"
+
+    filter { "configurations.Release" }
+        runtime "Release"
+
+
+-----------------------------------------------------------------------------------------
+-- headless benchmark of the blocked 3D kernels against a reference implementation
+project "field3d_bench"
+
+    kind "ConsoleApp"
+
+    targetdir ("%{wks.location}")
+	objdir ("%{wks.location}/obj")
+
+    files
+    {
+        "bench/field3d_bench.cpp",
+        "src/field3d.cpp",
+        "src/field3d.h",
+        "src/instrumentation.cpp",
+        "src/instrumentation.h",
+        "src/field.h",
+    }
+
+    includedirs
+    {
+        ".",
+    }
+
+    filter { "configurations.Debug" }
+        runtime "Debug"
+
+    filter { "configurations.Release" }
+        runtime "Release"
+
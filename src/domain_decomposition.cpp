@@ -0,0 +1,252 @@
+
+#include "domain_decomposition.h"
+#include "instrumentation.h"
+
+#include <assert.h>
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+
+
+//
+DomainDecomposition::DomainDecomposition(const glm::ivec2 &_global_shape, const glm::ivec2 &_ranks)
+{
+    assert(_ranks.x > 0 && _ranks.y > 0 && "empty process grid");
+    assert(_global_shape.x >= _ranks.x && _global_shape.y >= _ranks.y && "more ranks than cells");
+
+    m_globalShape = _global_shape;
+    m_ranks = _ranks;
+}
+
+//---------------------------------------------------------------------------------------
+int DomainDecomposition::neighbour(int _rank, int _dir) const
+{
+    glm::ivec2 c = coords(_rank);
+    switch (_dir)
+    {
+        case HALO_LEFT:     c.x--; break;
+        case HALO_RIGHT:    c.x++; break;
+        case HALO_BOTTOM:   c.y--; break;
+        case HALO_TOP:      c.y++; break;
+        default: break;
+    }
+
+    if (c.x < 0 || c.y < 0 || c.x >= m_ranks.x || c.y >= m_ranks.y)
+        return -1;
+    return c.y * m_ranks.x + c.x;
+}
+
+//---------------------------------------------------------------------------------------
+subdomain_box_t DomainDecomposition::box(int _rank) const
+{
+    // remainder cells go to the first subdomains along each axis
+    glm::ivec2 c = coords(_rank);
+    subdomain_box_t b;
+    for (int i = 0; i < 2; i++)
+    {
+        const int base = m_globalShape[i] / m_ranks[i];
+        const int rem  = m_globalShape[i] % m_ranks[i];
+        b.shape[i]  = base + (c[i] < rem ? 1 : 0);
+        b.origin[i] = c[i] * base + std::min(c[i], rem);
+    }
+    return b;
+}
+
+//---------------------------------------------------------------------------------------
+uint32_t DomainDecomposition::maxEdge() const
+{
+    const subdomain_box_t b = box(0);   // first subdomain is the largest
+    return (uint32_t)std::max(b.shape.x, b.shape.y);
+}
+
+//---------------------------------------------------------------------------------------
+glm::ivec2 DomainDecomposition::factor(int _n, const glm::ivec2 &_global_shape)
+{
+    glm::ivec2 best = { _n, 1 };
+    float best_aspect = FLT_MAX;
+    for (int px = 1; px <= _n; px++)
+    {
+        if (_n % px)
+            continue;
+        const int py = _n / px;
+        const float sx = (float)_global_shape.x / (float)px;
+        const float sy = (float)_global_shape.y / (float)py;
+        const float aspect = std::max(sx, sy) / std::min(sx, sy);
+        if (aspect < best_aspect)
+        {
+            best_aspect = aspect;
+            best = { px, py };
+        }
+    }
+    return best;
+}
+
+
+//---------------------------------------------------------------------------------------
+Subdomain::Subdomain(const DomainDecomposition &_decomp,
+                     int _rank,
+                     std::shared_ptr<HaloTransport> _transport,
+                     float _h) :
+    m_decomp(_decomp), m_rank(_rank), m_transport(_transport), m_h(_h)
+{
+    assert(m_transport->rank() == _rank && "transport not bound to this rank");
+
+    m_box = _decomp.box(_rank);
+    m_stride = m_box.shape.x + 2;
+
+    const glm::ivec2 padded = m_box.shape + glm::ivec2(2);
+    m_pressure = std::make_shared<Field1D>(padded);
+    m_rhs = std::make_shared<Field1D>(padded);
+    // ghost cells at the global boundary stay zero in both buffers
+    m_pressure->clear();
+    m_pressure->clear(true);
+    m_rhs->clear();
+
+    for (int d = 0; d < HALO_DIR_COUNT; d++)
+    {
+        m_neighbours[d] = _decomp.neighbour(_rank, d);
+        const int n = (d == HALO_LEFT || d == HALO_RIGHT) ? m_box.shape.y : m_box.shape.x;
+        if (m_neighbours[d] >= 0)
+        {
+            m_sendBuf[d].resize(n);
+            m_recvBuf[d].resize(n);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void Subdomain::jacobi()
+{
+    const float *p = m_pressure->data();
+    float *out = m_pressure->backBuffer();
+    const int nx = m_box.shape.x;
+    const int ny = m_box.shape.y;
+    // The two compute phases are timed separately from the halo exchange
+    // (halo_send / halo_recv). Per cell: read p and rhs, write p; 4 add/sub + 2 mul
+    [[maybe_unused]] const uint64_t interior = (uint64_t)std::max(nx - 2, 0) * std::max(ny - 2, 0);
+    [[maybe_unused]] const uint64_t ring = (uint64_t)nx * ny - interior;
+
+    send_halos_(p);
+
+    // interior, independent of the halo
+    {
+        INSTR_KERNEL("subdomain_jacobi_interior", interior * 12, interior * 6);
+        update_rows_(p, out, 1, ny - 1, 1, nx - 1);
+    }
+
+    recv_halos_(m_pressure->data());
+
+    // boundary ring
+    {
+        INSTR_KERNEL("subdomain_jacobi_ring", ring * 12, ring * 6);
+        update_rows_(p, out, 0, 1, 0, nx);
+        if (ny > 1)
+            update_rows_(p, out, ny - 1, ny, 0, nx);
+        update_rows_(p, out, 1, ny - 1, 0, 1);
+        if (nx > 1)
+            update_rows_(p, out, 1, ny - 1, nx - 1, nx);
+    }
+
+    m_pressure->swap();
+    m_sweeps++;
+}
+
+//---------------------------------------------------------------------------------------
+float Subdomain::residual()
+{
+    float *p = m_pressure->data();
+    const float *rhs = m_rhs->data();
+    const float inv_h2 = 1.0f / (m_h * m_h);
+
+    send_halos_(p);
+    recv_halos_(p);
+
+    // per cell: read p and rhs; 6 add/sub + 3 mul
+    double sum = 0.0;
+    {
+        INSTR_KERNEL("subdomain_residual", (uint64_t)m_box.shape.x * m_box.shape.y * 8, (uint64_t)m_box.shape.x * m_box.shape.y * 9);
+        for (int y = 0; y < m_box.shape.y; y++)
+        {
+            for (int x = 0; x < m_box.shape.x; x++)
+            {
+                const int i = idx(x, y);
+                const float lap = inv_h2 * (p[i - 1] + p[i + 1] + p[i - m_stride] + p[i + m_stride] - 4.0f * p[i]);
+                const float r = lap - rhs[i];
+                sum += (double)r * r;
+            }
+        }
+    }
+
+    const float res = (float)sqrt(m_transport->allreduceSum(sum));
+    INSTR_RESIDUAL("subdomain_jacobi", m_sweeps, res);
+    return res;
+}
+
+//---------------------------------------------------------------------------------------
+void Subdomain::send_halos_(const float *_p)
+{
+    const int nx = m_box.shape.x;
+    const int ny = m_box.shape.y;
+    INSTR_SCOPE("halo_send");
+
+    for (int d = 0; d < HALO_DIR_COUNT; d++)
+    {
+        if (m_neighbours[d] < 0)
+            continue;
+
+        float *buf = m_sendBuf[d].data();
+        switch (d)
+        {
+            case HALO_LEFT:     for (int y = 0; y < ny; y++) buf[y] = _p[idx(0, y)];      break;
+            case HALO_RIGHT:    for (int y = 0; y < ny; y++) buf[y] = _p[idx(nx - 1, y)]; break;
+            case HALO_BOTTOM:   memcpy(buf, &_p[idx(0, 0)], nx * sizeof(float));          break;
+            case HALO_TOP:      memcpy(buf, &_p[idx(0, ny - 1)], nx * sizeof(float));     break;
+            default: break;
+        }
+        m_transport->send(d, buf, (uint32_t)m_sendBuf[d].size());
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void Subdomain::recv_halos_(float *_p)
+{
+    const int nx = m_box.shape.x;
+    const int ny = m_box.shape.y;
+    // mostly time spent waiting, i.e. communication not hidden by the interior
+    INSTR_SCOPE("halo_recv");
+
+    for (int d = 0; d < HALO_DIR_COUNT; d++)
+    {
+        if (m_neighbours[d] < 0)
+            continue;
+
+        float *buf = m_recvBuf[d].data();
+        m_transport->recv(d, buf, (uint32_t)m_recvBuf[d].size());
+        switch (d)
+        {
+            case HALO_LEFT:     for (int y = 0; y < ny; y++) _p[idx(-1, y)] = buf[y]; break;
+            case HALO_RIGHT:    for (int y = 0; y < ny; y++) _p[idx(nx, y)] = buf[y]; break;
+            case HALO_BOTTOM:   memcpy(&_p[idx(0, -1)], buf, nx * sizeof(float));     break;
+            case HALO_TOP:      memcpy(&_p[idx(0, ny)], buf, nx * sizeof(float));     break;
+            default: break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void Subdomain::update_rows_(const float *_p, float *_out, int _y0, int _y1, int _x0, int _x1)
+{
+    const float *rhs = m_rhs->data();
+    const float h2 = m_h * m_h;
+
+    for (int y = _y0; y < _y1; y++)
+    {
+        for (int x = _x0; x < _x1; x++)
+        {
+            const int i = idx(x, y);
+            _out[i] = 0.25f * (_p[i - 1] + _p[i + 1] + _p[i - m_stride] + _p[i + m_stride] - h2 * rhs[i]);
+        }
+    }
+}
+
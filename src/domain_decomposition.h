@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "field.h"
+#include "halo_transport.h"
+
+
+//
+struct subdomain_box_t
+{
+    glm::ivec2 origin;  // first owned cell in global coordinates
+    glm::ivec2 shape;   // owned cells, excluding halo
+};
+
+
+// Splits a global 2D grid into a px x py grid of subdomains, one per rank.
+// Ranks are numbered row-major over the process grid.
+class DomainDecomposition
+{
+public:
+    DomainDecomposition(const glm::ivec2 &_global_shape, const glm::ivec2 &_ranks);
+
+    //
+    int rankCount() const { return m_ranks.x * m_ranks.y; }
+    const glm::ivec2 &ranks() const { return m_ranks; }
+    const glm::ivec2 &globalShape() const { return m_globalShape; }
+    glm::ivec2 coords(int _rank) const { return { _rank % m_ranks.x, _rank / m_ranks.x }; }
+
+    // Rank of the neighbour in direction _dir, -1 at the global boundary.
+    int neighbour(int _rank, int _dir) const;
+
+    //
+    subdomain_box_t box(int _rank) const;
+
+    // Longest halo edge of any subdomain, in cells.
+    uint32_t maxEdge() const;
+
+    // Process grid for _n ranks with subdomains as close to square as possible.
+    static glm::ivec2 factor(int _n, const glm::ivec2 &_global_shape);
+
+
+private:
+    glm::ivec2 m_globalShape = { 0, 0 };
+    glm::ivec2 m_ranks = { 1, 1 };
+
+};
+
+
+// The part of the pressure solve owned by one rank: padded fields with a
+// one-cell halo, filled from the neighbours through a HaloTransport. The global
+// boundary is Dirichlet p = 0.
+class Subdomain
+{
+public:
+    Subdomain(const DomainDecomposition &_decomp,
+              int _rank,
+              std::shared_ptr<HaloTransport> _transport,
+              float _h);
+    ~Subdomain() = default;
+
+    // One Jacobi sweep. Halos are sent first, the interior is updated while
+    // they are in flight and the boundary ring once they have arrived.
+    void jacobi();
+
+    // Global L2 norm of lap(p) - rhs.
+    float residual();
+
+    // Padded row-major (shape + 2) fields, owned cell (x, y) at (x+1, y+1).
+    Field1D *pressure() { return m_pressure.get(); }
+    Field1D *rhs() { return m_rhs.get(); }
+    __always_inline int idx(int _x, int _y) const { return (_y + 1) * m_stride + _x + 1; }
+
+    //
+    const subdomain_box_t &box() const { return m_box; }
+    int rank() const { return m_rank; }
+    uint32_t sweeps() const { return m_sweeps; }
+
+
+private:
+    void send_halos_(const float *_p);
+    void recv_halos_(float *_p);
+    void update_rows_(const float *_p, float *_out, int _y0, int _y1, int _x0, int _x1);
+
+private:
+    const DomainDecomposition &m_decomp;
+    int m_rank;
+    std::shared_ptr<HaloTransport> m_transport = nullptr;
+    float m_h;
+
+    subdomain_box_t m_box;
+    int m_stride = 0;
+    int m_neighbours[HALO_DIR_COUNT];
+    uint32_t m_sweeps = 0;
+
+    std::shared_ptr<Field1D> m_pressure = nullptr;
+    std::shared_ptr<Field1D> m_rhs = nullptr;
+    // packed halo rows/columns
+    std::vector<float> m_sendBuf[HALO_DIR_COUNT];
+    std::vector<float> m_recvBuf[HALO_DIR_COUNT];
+
+};
+
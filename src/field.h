@@ -6,6 +6,8 @@
 #include <string.h>
 #include <memory>
 
+#include "instrumentation.h"
+
 //
 #define ASSERT_SZ(f) assert(f.size() == m_n)
 #define ASSERT_SZ_PTR(f) assert(f->size() == m_n)
@@ -21,7 +23,12 @@ public:
     Field() {}
     Field(uint32_t _cell_count) : m_n(_cell_count) { new_(); }
     Field(const glm::ivec2 &_shape) : m_n(_shape.x * _shape.y) { new_(); } 
-    ~Field() { if (m_data) delete[] m_data; if (m_swap) delete[] m_swap; }
+    Field(const glm::ivec3 &_shape) : m_n((uint32_t)_shape.x * _shape.y * _shape.z) { new_(); }
+    ~Field()
+    {
+        if (m_data) { delete[] m_data; INSTR_FREE(m_sz_bytes); }
+        if (m_swap) { delete[] m_swap; INSTR_FREE(m_sz_bytes); }
+    }
 
     //
     void set(T &_val, bool _back_buffer=false)
@@ -43,14 +50,14 @@ public:
     {
         T *t = m_data;
         m_data = m_swap;
-        m_swap = m_data;
+        m_swap = t;
     }
 
     //
     T *data() { return m_data; }
     T *backBuffer() { return m_swap; }
     uint32_t size() { return m_n; }
-    uint32_t size_bytes() { return m_sz_bytes; }
+    size_t size_bytes() { return m_sz_bytes; }
 
     //
     void copyFrom(Field &_f) { ASSERT_SZ(_f); memcpy(m_data, _f.data(), m_sz_bytes); }
@@ -64,18 +71,21 @@ private:
         m_data = new T[m_n];
         m_swap = new T[m_n];
         m_sz_bytes = sizeof(T) * m_n;
+        INSTR_ALLOC(m_sz_bytes);
+        INSTR_ALLOC(m_sz_bytes);
     }
 
 private:
     T *m_data = nullptr;
     T *m_swap = nullptr;
 
-    uint32_t m_n;
-    uint32_t m_sz_bytes;
+    uint32_t m_n = 0;
+    size_t m_sz_bytes = 0;  // may exceed 4 GB for large 3D vector fields
     
 };
 
 using Field1D = Field<float>;
 using Field2D = Field<glm::vec2>;
+using Field3D = Field<glm::vec3>;
 
 
@@ -0,0 +1,209 @@
+
+#include "field3d.h"
+#include "instrumentation.h"
+
+#include <assert.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+
+//
+enum boundary_t
+{
+    BOUNDARY_CLAMP, // replicate the edge (zero gradient)
+    BOUNDARY_ZERO,  // zero outside the domain
+};
+
+// The five neighbouring rows of row (y, z), all _shape.x cells long. Rows
+// outside the domain point at the clamped row, or at a row of zeros.
+template<typename T>
+struct stencil_rows_t
+{
+    const T *c;
+    const T *ym;
+    const T *yp;
+    const T *zm;
+    const T *zp;
+};
+
+// Calls _row(rows, y, z) for every row of _src. Rows are visited in blocks of
+// FIELD3D_BLOCK_Y, each block streaming along z, so the rows of the previous
+// plane are still cached when the next one reads them.
+template<typename T, typename F>
+static void stream_rows_(const T *_src, const glm::ivec3 &_shape, boundary_t _boundary, F _row)
+{
+    const std::vector<T> zeros(_shape.x, T(0));
+    auto row = [&](int _y, int _z) -> const T *
+    {
+        if (_y < 0 || _y >= _shape.y || _z < 0 || _z >= _shape.z)
+        {
+            if (_boundary == BOUNDARY_ZERO)
+                return zeros.data();
+            _y = std::min(std::max(_y, 0), _shape.y - 1);
+            _z = std::min(std::max(_z, 0), _shape.z - 1);
+        }
+        return &_src[field3d_idx(_shape, 0, _y, _z)];
+    };
+
+    for (int y0 = 0; y0 < _shape.y; y0 += FIELD3D_BLOCK_Y)
+    {
+        const int y1 = std::min(y0 + FIELD3D_BLOCK_Y, _shape.y);
+        for (int z = 0; z < _shape.z; z++)
+            for (int y = y0; y < y1; y++)
+                _row(stencil_rows_t<T>{ row(y, z), row(y - 1, z), row(y + 1, z), row(y, z - 1), row(y, z + 1) }, y, z);
+    }
+}
+
+// Calls _cell(x, left, right) along a row of _nx cells; the two end cells are
+// peeled off so that the interior loop has no boundary test.
+template<typename T, typename F>
+static __always_inline void for_row_(const T *_c, int _nx, boundary_t _boundary, F _cell)
+{
+    const T left  = (_boundary == BOUNDARY_ZERO ? T(0) : _c[0]);
+    const T right = (_boundary == BOUNDARY_ZERO ? T(0) : _c[_nx - 1]);
+    if (_nx == 1)
+    {
+        _cell(0, left, right);
+        return;
+    }
+
+    _cell(0, left, _c[1]);
+    for (int x = 1; x < _nx - 1; x++)
+        _cell(x, _c[x - 1], _c[x + 1]);
+    _cell(_nx - 1, _c[_nx - 2], right);
+}
+
+
+//---------------------------------------------------------------------------------------
+void gradient3d(Field1D *_f, Field3D *_grad, const glm::ivec3 &_shape, float _h)
+{
+    [[maybe_unused]] const size_t n = (size_t)_shape.x * _shape.y * _shape.z;
+    assert(_f->size() == n && _grad->size() == n);
+    // per cell: read 1 float, write 1 vec3; 3 sub + 3 mul
+    INSTR_KERNEL("gradient3d", n * 16, n * 6);
+
+    const float inv_2h = 1.0f / (2.0f * _h);
+    glm::vec3 *g = _grad->data();
+
+    stream_rows_(_f->data(), _shape, BOUNDARY_CLAMP,
+        [&](const stencil_rows_t<float> &_r, int _y, int _z)
+        {
+            glm::vec3 *out = &g[field3d_idx(_shape, 0, _y, _z)];
+            for_row_(_r.c, _shape.x, BOUNDARY_CLAMP, [&](int _x, float _xm, float _xp)
+            {
+                out[_x] = { (_xp - _xm) * inv_2h,
+                            (_r.yp[_x] - _r.ym[_x]) * inv_2h,
+                            (_r.zp[_x] - _r.zm[_x]) * inv_2h };
+            });
+        });
+}
+
+//---------------------------------------------------------------------------------------
+void divergence3d(Field3D *_v, Field1D *_div, const glm::ivec3 &_shape, float _h)
+{
+    [[maybe_unused]] const size_t n = (size_t)_shape.x * _shape.y * _shape.z;
+    assert(_v->size() == n && _div->size() == n);
+    // per cell: read 1 vec3, write 1 float; 5 add/sub + 1 mul
+    INSTR_KERNEL("divergence3d", n * 16, n * 6);
+
+    const float inv_2h = 1.0f / (2.0f * _h);
+    float *d = _div->data();
+
+    stream_rows_(_v->data(), _shape, BOUNDARY_CLAMP,
+        [&](const stencil_rows_t<glm::vec3> &_r, int _y, int _z)
+        {
+            float *out = &d[field3d_idx(_shape, 0, _y, _z)];
+            for_row_(_r.c, _shape.x, BOUNDARY_CLAMP, [&](int _x, const glm::vec3 &_xm, const glm::vec3 &_xp)
+            {
+                out[_x] = inv_2h * (_xp.x - _xm.x +
+                                    _r.yp[_x].y - _r.ym[_x].y +
+                                    _r.zp[_x].z - _r.zm[_x].z);
+            });
+        });
+}
+
+//---------------------------------------------------------------------------------------
+void jacobi3d(Field1D *_p, Field1D *_rhs, const glm::ivec3 &_shape, float _h)
+{
+    [[maybe_unused]] const size_t n = (size_t)_shape.x * _shape.y * _shape.z;
+    assert(_p->size() == n && _rhs->size() == n);
+    // per cell: read p and rhs, write p; 6 add/sub + 2 mul
+    INSTR_KERNEL("jacobi3d", n * 12, n * 8);
+
+    const float h2 = _h * _h;
+    const float inv_6 = 1.0f / 6.0f;
+    const float *rhs = _rhs->data();
+    float *out = _p->backBuffer();
+
+    stream_rows_(_p->data(), _shape, BOUNDARY_ZERO,
+        [&](const stencil_rows_t<float> &_r, int _y, int _z)
+        {
+            const size_t row = field3d_idx(_shape, 0, _y, _z);
+            float *o = &out[row];
+            const float *b = &rhs[row];
+            for_row_(_r.c, _shape.x, BOUNDARY_ZERO, [&](int _x, float _xm, float _xp)
+            {
+                o[_x] = inv_6 * (_xm + _xp + _r.ym[_x] + _r.yp[_x] + _r.zm[_x] + _r.zp[_x] - h2 * b[_x]);
+            });
+        });
+
+    _p->swap();
+}
+
+//---------------------------------------------------------------------------------------
+float residual3d(Field1D *_p, Field1D *_rhs, const glm::ivec3 &_shape, float _h)
+{
+    [[maybe_unused]] const size_t n = (size_t)_shape.x * _shape.y * _shape.z;
+    assert(_p->size() == n && _rhs->size() == n);
+    // per cell: read p and rhs; 8 add/sub + 3 mul
+    INSTR_KERNEL("residual3d", n * 8, n * 11);
+
+    const float inv_h2 = 1.0f / (_h * _h);
+    const float *rhs = _rhs->data();
+    double sum = 0.0;
+
+    stream_rows_(_p->data(), _shape, BOUNDARY_ZERO,
+        [&](const stencil_rows_t<float> &_r, int _y, int _z)
+        {
+            const float *b = &rhs[field3d_idx(_shape, 0, _y, _z)];
+            for_row_(_r.c, _shape.x, BOUNDARY_ZERO, [&](int _x, float _xm, float _xp)
+            {
+                const float lap = inv_h2 * (_xm + _xp + _r.ym[_x] + _r.yp[_x] + _r.zm[_x] + _r.zp[_x] - 6.0f * _r.c[_x]);
+                const float r = lap - b[_x];
+                sum += (double)r * r;
+            });
+        });
+
+    return (float)sqrt(sum);
+}
+
+//---------------------------------------------------------------------------------------
+uint32_t pressure_solve3d(Field1D *_p,
+                          Field1D *_rhs,
+                          const glm::ivec3 &_shape,
+                          float _h,
+                          uint32_t _max_iterations,
+                          float _tolerance,
+                          uint32_t _check_interval)
+{
+    INSTR_SCOPE("pressure_solve3d");
+    _check_interval = std::max(_check_interval, 1u);
+
+    uint32_t i = 0;
+    while (i < _max_iterations)
+    {
+        jacobi3d(_p, _rhs, _shape, _h);
+        i++;
+
+        if (i % _check_interval == 0 || i == _max_iterations)
+        {
+            const float r = residual3d(_p, _rhs, _shape, _h);
+            INSTR_RESIDUAL("pressure_solve3d", i, r);
+            if (r < _tolerance)
+                break;
+        }
+    }
+    return i;
+}
+
@@ -1,5 +1,6 @@
 
 #include "field_renderer.h"
+#include "field3d.h"
 
 #include <synapse/API>
 #include <math.h>
@@ -88,6 +89,34 @@ void FieldRenderer::renderField1D()
 
 }
 
+//---------------------------------------------------------------------------------------
+void FieldRenderer::setSlice3D(Field1D *_field_3d, const glm::ivec3 &_shape, int _axis, int _index)
+{
+    assert(_axis >= 0 && _axis < 3 && "invalid slice axis");
+    assert(_index >= 0 && _index < _shape[_axis] && "slice index out of range");
+
+    // in-plane axes of the slice, mapped to texture x and y
+    const int u = (_axis == 0 ? 1 : 0);
+    const int v = (_axis == 2 ? 1 : 2);
+    assert(_shape[u] == m_shape.x && _shape[v] == m_shape.y && "slice shape != renderer shape");
+
+    const float *src = _field_3d->data();
+    glm::ivec3 c;
+    c[_axis] = _index;
+    for (int y = 0; y < m_shape.y; y++)
+    {
+        c[v] = y;
+        for (int x = 0; x < m_shape.x; x++)
+        {
+            c[u] = x;
+            m_data1D[y * m_shape.x + x] = src[field3d_idx(_shape, c.x, c.y, c.z)];
+        }
+    }
+
+    normalize_field_1d();
+    updateData1D();
+}
+
 //---------------------------------------------------------------------------------------
 void FieldRenderer::updateData2D()
 {
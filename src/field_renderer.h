@@ -62,6 +62,11 @@ public:
         updateData1D();
     }
 
+    // Shows an axis-aligned slice of a 3D scalar field through the scalar texture.
+    // _axis is the normal of the slice (0 = x, 1 = y, 2 = z); the slice must have
+    // the shape of the renderer: (y, z) for x, (x, z) for y and (x, y) for z.
+    void setSlice3D(Field1D *_field_3d, const glm::ivec3 &_shape, int _axis, int _index);
+
     // Sets the vector field data pointer
     __always_inline void setData2D(std::shared_ptr<Field2D> _field_2d) { setData2D(_field_2d.get()); }
     __always_inline void setData2D(Field2D *_field_2d)
@@ -0,0 +1,394 @@
+
+#include "halo_transport.h"
+#include "domain_decomposition.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <new>
+
+
+//
+static void fatal_errno(const char *_what)
+{
+    fprintf(stderr, "halo transport: %s: %s\n", _what, strerror(errno));
+    abort();
+}
+
+//
+static void fatal(const char *_what)
+{
+    fprintf(stderr, "halo transport: %s\n", _what);
+    abort();
+}
+
+//
+static double now_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+std::shared_ptr<HaloTransport> HaloTransport::create(TransportType _type, const DomainDecomposition &_decomp)
+{
+    switch (_type)
+    {
+        case TransportType::SharedMemory:   return std::make_shared<ShmTransport>(_decomp);
+        case TransportType::UnixSocket:     return std::make_shared<SocketTransport>(_decomp);
+        default: break;
+    }
+    return nullptr;
+}
+
+
+//---------------------------------------------------------------------------------------
+ShmTransport::ShmTransport(const DomainDecomposition &_decomp) :
+    m_decomp(_decomp)
+{
+    m_name = "shm";
+    m_rankCount = _decomp.rankCount();
+    m_maxEdge = _decomp.maxEdge();
+
+    // cache line aligned mailboxes, followed by the reduction slots
+    m_mailboxSz = (sizeof(mailbox_t) + 2 * m_maxEdge * sizeof(float) + 63) & ~(size_t)63;
+    m_reduceOffset = m_mailboxSz * m_rankCount * HALO_DIR_COUNT;
+    m_abortOffset = m_reduceOffset + ((sizeof(reduce_slot_t) + 63) & ~(size_t)63) * m_rankCount;
+    m_segmentSz = m_abortOffset + 64;
+    m_parent = (int)getpid();
+
+    // named segment, unlinked as soon as it is mapped: the mapping is inherited
+    // by the forked ranks and released with the last of them
+    char name[64];
+    snprintf(name, sizeof(name), "/pressure_solver_halo_%d", (int)getpid());
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        fatal_errno("shm_open");
+    if (ftruncate(fd, m_segmentSz) != 0)
+        fatal_errno("ftruncate");
+
+    void *p = mmap(nullptr, m_segmentSz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        fatal_errno("mmap");
+    close(fd);
+    shm_unlink(name);
+
+    m_segment = (uint8_t *)p;
+    for (int r = 0; r < m_rankCount; r++)
+    {
+        for (int d = 0; d < HALO_DIR_COUNT; d++)
+        {
+            mailbox_t *mb = new (mailbox_(r, d)) mailbox_t;
+            mb->seq[0].store(0);
+            mb->seq[1].store(0);
+        }
+        reduce_slot_t *rs = new (reduce_slot_(r)) reduce_slot_t;
+        rs->seq[0].store(0);
+        rs->seq[1].store(0);
+    }
+    new (abort_flag_()) std::atomic<uint32_t>(0);
+}
+
+//---------------------------------------------------------------------------------------
+ShmTransport::~ShmTransport()
+{
+    if (m_segment)
+        munmap(m_segment, m_segmentSz);
+}
+
+//---------------------------------------------------------------------------------------
+void ShmTransport::bind(int _rank)
+{
+    assert(_rank >= -1 && _rank < m_rankCount);
+    m_rank = _rank;
+}
+
+//---------------------------------------------------------------------------------------
+void ShmTransport::abort()
+{
+    abort_flag_()->store(1, std::memory_order_release);
+}
+
+//---------------------------------------------------------------------------------------
+// Spins on _cond, yielding the cpu after a while so that oversubscribed runs
+// (more ranks than cores) still make progress. Every few thousand polls it
+// checks that the run is still alive.
+template<typename F>
+void ShmTransport::wait_until_(F _cond)
+{
+    uint32_t n = 0;
+    double deadline = 0.0;
+    while (!_cond())
+    {
+        if (++n > 256)
+            sched_yield();
+        if ((n & 4095) != 0)
+            continue;
+
+        if (abort_flag_()->load(std::memory_order_acquire))
+            fatal("aborted by parent");
+        if ((int)getppid() != m_parent)
+            fatal("parent exited");
+        const double t = now_s();
+        if (deadline == 0.0)
+            deadline = t + HALO_WAIT_TIMEOUT_S;
+        else if (t > deadline)
+            fatal("timed out waiting for a peer");
+    }
+}
+
+//---------------------------------------------------------------------------------------
+ShmTransport::mailbox_t *ShmTransport::mailbox_(int _rank, int _dir)
+{
+    return (mailbox_t *)(m_segment + m_mailboxSz * (_rank * HALO_DIR_COUNT + _dir));
+}
+
+//---------------------------------------------------------------------------------------
+ShmTransport::reduce_slot_t *ShmTransport::reduce_slot_(int _rank)
+{
+    const size_t slot_sz = (sizeof(reduce_slot_t) + 63) & ~(size_t)63;
+    return (reduce_slot_t *)(m_segment + m_reduceOffset + slot_sz * _rank);
+}
+
+//---------------------------------------------------------------------------------------
+void ShmTransport::send(int _dir, const float *_buf, uint32_t _n)
+{
+    assert(_n <= m_maxEdge);
+    const int nb = m_decomp.neighbour(m_rank, _dir);
+    assert(nb >= 0 && "no neighbour in this direction");
+
+    // The neighbour receives from the opposite direction. Message k goes to slot
+    // k & 1; lock-step exchanges guarantee that message k-2 has been consumed.
+    const uint64_t k = ++m_sendSeq[_dir];
+    mailbox_t *mb = mailbox_(nb, halo_opposite(_dir));
+    memcpy(mailbox_data_(mb, k & 1), _buf, _n * sizeof(float));
+    mb->seq[k & 1].store(k, std::memory_order_release);
+}
+
+//---------------------------------------------------------------------------------------
+void ShmTransport::recv(int _dir, float *_buf, uint32_t _n)
+{
+    assert(_n <= m_maxEdge);
+    const uint64_t k = ++m_recvSeq[_dir];
+    mailbox_t *mb = mailbox_(m_rank, _dir);
+    wait_until_([&]() { return mb->seq[k & 1].load(std::memory_order_acquire) == k; });
+    memcpy(_buf, mailbox_data_(mb, k & 1), _n * sizeof(float));
+}
+
+//---------------------------------------------------------------------------------------
+double ShmTransport::allreduceSum(double _val)
+{
+    const uint64_t k = ++m_reduceSeq;
+    const int s = k & 1;
+
+    reduce_slot_t *own = reduce_slot_(m_rank);
+    own->val[s] = _val;
+    own->seq[s].store(k, std::memory_order_release);
+
+    // summed in rank order on every rank, so all ranks get the same bits
+    double sum = 0.0;
+    for (int r = 0; r < m_rankCount; r++)
+    {
+        reduce_slot_t *rs = reduce_slot_(r);
+        wait_until_([&]() { return rs->seq[s].load(std::memory_order_acquire) == k; });
+        sum += rs->val[s];
+    }
+    return sum;
+}
+
+
+//---------------------------------------------------------------------------------------
+// MSG_NOSIGNAL: a dead peer shows up as EPIPE rather than killing the rank.
+static void write_all(int _fd, const void *_buf, size_t _sz)
+{
+    const uint8_t *p = (const uint8_t *)_buf;
+    while (_sz)
+    {
+        ssize_t n = ::send(_fd, p, _sz, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) fatal("timed out sending to a peer");
+            fatal_errno("send");
+        }
+        p += n;
+        _sz -= n;
+    }
+}
+
+//
+static void read_all(int _fd, void *_buf, size_t _sz)
+{
+    uint8_t *p = (uint8_t *)_buf;
+    while (_sz)
+    {
+        ssize_t n = read(_fd, p, _sz);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) fatal("timed out waiting for a peer");
+            fatal_errno("read");
+        }
+        if (n == 0)
+            fatal("peer closed connection");
+        p += n;
+        _sz -= n;
+    }
+}
+
+// Asks for _buf_sz bytes of buffering per direction and fails unless at least
+// _min_sz were granted: with less than one message buffered, two neighbours
+// sending to each other both block in write_all() forever. The kernel caps the
+// request at net.core.wmem_max without an error, so the size is read back.
+// Reads and writes time out after HALO_WAIT_TIMEOUT_S.
+static void socket_pair(int *_fds, size_t _buf_sz, size_t _min_sz)
+{
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, _fds) != 0)
+        fatal_errno("socketpair");
+
+    const int sz = (int)_buf_sz;
+    const timeval timeout = { HALO_WAIT_TIMEOUT_S, 0 };
+    for (int i = 0; i < 2; i++)
+    {
+        if (setsockopt(_fds[i], SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz)) != 0 ||
+            setsockopt(_fds[i], SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz)) != 0)
+            fatal_errno("setsockopt(SO_SNDBUF / SO_RCVBUF)");
+        if (setsockopt(_fds[i], SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0 ||
+            setsockopt(_fds[i], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+            fatal_errno("setsockopt(SO_SNDTIMEO / SO_RCVTIMEO)");
+
+        // Linux reports twice the usable size (the rest is bookkeeping)
+        int granted = 0;
+        socklen_t len = sizeof(granted);
+        if (getsockopt(_fds[i], SOL_SOCKET, SO_SNDBUF, &granted, &len) != 0)
+            fatal_errno("getsockopt(SO_SNDBUF)");
+        if ((size_t)granted / 2 < _min_sz)
+        {
+            fprintf(stderr, "halo transport: socket buffer of %d bytes cannot hold a %zu byte halo, "
+                            "raise net.core.wmem_max or use the shm transport\n", granted / 2, _min_sz);
+            abort();
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+SocketTransport::SocketTransport(const DomainDecomposition &_decomp) :
+    m_decomp(_decomp)
+{
+    m_name = "socket";
+    m_rankCount = _decomp.rankCount();
+    m_haloFds.assign(m_rankCount * HALO_DIR_COUNT, -1);
+    m_reduceFds.assign(2 * m_rankCount, -1);
+
+    // room for a couple of exchanges in each direction; one is required
+    const size_t edge_sz = _decomp.maxEdge() * sizeof(float);
+    const size_t buf_sz = 4 * edge_sz + 4096;
+
+    for (int r = 0; r < m_rankCount; r++)
+    {
+        // one pair per neighbour pair, created from the left / bottom side
+        for (int d : { HALO_RIGHT, HALO_TOP })
+        {
+            const int nb = _decomp.neighbour(r, d);
+            if (nb < 0)
+                continue;
+            int fds[2];
+            socket_pair(fds, buf_sz, edge_sz);
+            m_haloFds[r * HALO_DIR_COUNT + d] = fds[0];
+            m_haloFds[nb * HALO_DIR_COUNT + halo_opposite(d)] = fds[1];
+        }
+
+        if (r > 0)
+        {
+            int fds[2];
+            socket_pair(fds, 4096, sizeof(double));
+            m_reduceFds[r] = fds[0];
+            m_reduceFds[m_rankCount + r] = fds[1];
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+SocketTransport::~SocketTransport()
+{
+    for (int fd : m_haloFds)   if (fd >= 0) close(fd);
+    for (int fd : m_reduceFds) if (fd >= 0) close(fd);
+}
+
+//---------------------------------------------------------------------------------------
+void SocketTransport::bind(int _rank)
+{
+    assert(_rank >= -1 && _rank < m_rankCount);
+    m_rank = _rank;
+
+    // drop the ends belonging to other ranks (all of them in the parent)
+    for (int r = 0; r < m_rankCount; r++)
+    {
+        if (r == _rank)
+            continue;
+        for (int d = 0; d < HALO_DIR_COUNT; d++)
+        {
+            int &fd = m_haloFds[r * HALO_DIR_COUNT + d];
+            if (fd >= 0) { close(fd); fd = -1; }
+        }
+        int &fd = m_reduceFds[r];
+        if (fd >= 0) { close(fd); fd = -1; }
+    }
+    if (_rank != 0)
+    {
+        for (int r = 0; r < m_rankCount; r++)
+        {
+            int &fd = m_reduceFds[m_rankCount + r];
+            if (fd >= 0) { close(fd); fd = -1; }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void SocketTransport::send(int _dir, const float *_buf, uint32_t _n)
+{
+    const int fd = m_haloFds[m_rank * HALO_DIR_COUNT + _dir];
+    assert(fd >= 0 && "no neighbour in this direction");
+    write_all(fd, _buf, _n * sizeof(float));
+}
+
+//---------------------------------------------------------------------------------------
+void SocketTransport::recv(int _dir, float *_buf, uint32_t _n)
+{
+    const int fd = m_haloFds[m_rank * HALO_DIR_COUNT + _dir];
+    assert(fd >= 0 && "no neighbour in this direction");
+    read_all(fd, _buf, _n * sizeof(float));
+}
+
+//---------------------------------------------------------------------------------------
+double SocketTransport::allreduceSum(double _val)
+{
+    if (m_rank != 0)
+    {
+        write_all(m_reduceFds[m_rank], &_val, sizeof(double));
+        read_all(m_reduceFds[m_rank], &_val, sizeof(double));
+        return _val;
+    }
+
+    double sum = _val;
+    for (int r = 1; r < m_rankCount; r++)
+    {
+        double v;
+        read_all(m_reduceFds[m_rankCount + r], &v, sizeof(double));
+        sum += v;
+    }
+    for (int r = 1; r < m_rankCount; r++)
+        write_all(m_reduceFds[m_rankCount + r], &sum, sizeof(double));
+    return sum;
+}
+
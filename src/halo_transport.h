@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+// Longest a rank waits on the transport without progress.
+#ifndef HALO_WAIT_TIMEOUT_S
+    #define HALO_WAIT_TIMEOUT_S     60
+#endif
+
+
+// Halo directions, as seen from the sending subdomain. Opposite directions
+// differ in the lowest bit.
+enum HaloDir : int
+{
+    HALO_LEFT   = 0,
+    HALO_RIGHT  = 1,
+    HALO_BOTTOM = 2,
+    HALO_TOP    = 3,
+    HALO_DIR_COUNT,
+};
+__always_inline int halo_opposite(int _dir) { return _dir ^ 1; }
+
+//
+enum class TransportType
+{
+    SharedMemory,
+    UnixSocket,
+};
+
+class DomainDecomposition;
+
+
+// Moves halo rows/columns between the processes owning neighbouring subdomains.
+// A transport is created once in the parent, before forking the ranks, and each
+// child then calls bind() with its rank; the parent calls bind(-1) once all
+// ranks are forked, so that it holds no connection a rank could wait on.
+// Exchanges are lock-step: every rank sends to and receives from each of its
+// neighbours once per exchange, in any order, and every rank takes part in
+// every reduction.
+class HaloTransport
+{
+public:
+    virtual ~HaloTransport() = default;
+
+    // _rank = -1 in the parent.
+    virtual void bind(int _rank) = 0;
+
+    // Hands off _n floats for the neighbour in direction _dir; returns without
+    // waiting for the neighbour to receive.
+    virtual void send(int _dir, const float *_buf, uint32_t _n) = 0;
+
+    // Blocks until the halo from the neighbour in direction _dir has arrived.
+    virtual void recv(int _dir, float *_buf, uint32_t _n) = 0;
+
+    // Sum over all ranks, identical (bitwise) on every rank.
+    virtual double allreduceSum(double _val) = 0;
+
+    // Called by the parent when a rank has died: ranks still waiting on the
+    // transport abort instead of blocking forever.
+    virtual void abort() {}
+
+    //
+    int rank() const { return m_rank; }
+    const char *name() const { return m_name; }
+
+    //
+    static std::shared_ptr<HaloTransport> create(TransportType _type, const DomainDecomposition &_decomp);
+
+
+protected:
+    int m_rank = -1;
+    const char *m_name = "";
+
+};
+
+
+// Mailboxes in a shared memory segment: every (rank, direction) pair owns a
+// double-buffered incoming slot guarded by a sequence number. Waits give up
+// (abort) when the parent sets the shared abort flag or exits, or after
+// HALO_WAIT_TIMEOUT_S seconds without progress.
+class ShmTransport : public HaloTransport
+{
+public:
+    ShmTransport(const DomainDecomposition &_decomp);
+    virtual ~ShmTransport();
+
+    virtual void bind(int _rank) override;
+    virtual void send(int _dir, const float *_buf, uint32_t _n) override;
+    virtual void recv(int _dir, float *_buf, uint32_t _n) override;
+    virtual double allreduceSum(double _val) override;
+    virtual void abort() override;
+
+private:
+    struct mailbox_t
+    {
+        std::atomic<uint64_t> seq[2];
+        // followed by 2 * m_maxEdge floats
+    };
+
+    struct reduce_slot_t
+    {
+        std::atomic<uint64_t> seq[2];
+        double val[2];
+    };
+
+    mailbox_t *mailbox_(int _rank, int _dir);
+    float *mailbox_data_(mailbox_t *_mb, int _slot) { return (float *)(_mb + 1) + _slot * m_maxEdge; }
+    reduce_slot_t *reduce_slot_(int _rank);
+    std::atomic<uint32_t> *abort_flag_() { return (std::atomic<uint32_t> *)(m_segment + m_abortOffset); }
+    template<typename F>
+    void wait_until_(F _cond);
+
+private:
+    const DomainDecomposition &m_decomp;
+    int m_rankCount     = 0;
+    uint32_t m_maxEdge  = 0;
+
+    uint8_t *m_segment  = nullptr;
+    size_t m_segmentSz  = 0;
+    size_t m_mailboxSz  = 0;
+    size_t m_reduceOffset = 0;
+    size_t m_abortOffset = 0;
+    int m_parent        = 0;    // pid of the process that created the transport
+
+    uint64_t m_sendSeq[HALO_DIR_COUNT] = { 0 };
+    uint64_t m_recvSeq[HALO_DIR_COUNT] = { 0 };
+    uint64_t m_reduceSeq = 0;
+
+};
+
+
+// Unix domain socket pairs between neighbours, plus a star onto rank 0 for
+// reductions. A rank that dies closes its ends, so its peers see end-of-file
+// (or EPIPE) and abort in turn; reads and writes time out after
+// HALO_WAIT_TIMEOUT_S. Every socket must buffer at least one full halo, so the
+// largest edge is bounded by net.core.wmem_max; creation aborts if it is not.
+class SocketTransport : public HaloTransport
+{
+public:
+    SocketTransport(const DomainDecomposition &_decomp);
+    virtual ~SocketTransport();
+
+    virtual void bind(int _rank) override;
+    virtual void send(int _dir, const float *_buf, uint32_t _n) override;
+    virtual void recv(int _dir, float *_buf, uint32_t _n) override;
+    virtual double allreduceSum(double _val) override;
+
+private:
+    const DomainDecomposition &m_decomp;
+    int m_rankCount = 0;
+
+    // [rank * HALO_DIR_COUNT + dir] -> fd, -1 if no neighbour
+    std::vector<int> m_haloFds;
+    // [rank] -> rank's end of the socket to rank 0, [rank_count + rank] -> rank 0's end
+    std::vector<int> m_reduceFds;
+
+};
+
@@ -0,0 +1,148 @@
+
+#include "instrumentation.h"
+
+#include <string.h>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+
+//
+Instrumentation::Instrumentation()
+{
+    m_kernels.reserve(64);
+    reset();
+}
+
+//---------------------------------------------------------------------------------------
+kernel_stats_t *Instrumentation::kernel(const char *_name)
+{
+    for (kernel_stats_t *k : m_kernels)
+        if (k->name == _name || strcmp(k->name, _name) == 0)
+            return k;
+
+    // never freed: call sites cache the pointer
+    kernel_stats_t *k = new kernel_stats_t;
+    k->name = _name;
+    m_kernels.push_back(k);
+    return k;
+}
+
+//---------------------------------------------------------------------------------------
+void Instrumentation::reset()
+{
+    for (kernel_stats_t *k : m_kernels)
+    {
+        const char *name = k->name;
+        *k = kernel_stats_t();
+        k->name = name;
+    }
+
+    m_events.clear();
+    m_events.reserve(std::min(m_maxEvents, (size_t)(1 << 16)));
+    m_droppedEvents = 0;
+    m_residuals.clear();
+
+    m_allocs = m_frees = m_allocBytes = 0;
+    m_peakBytes = m_liveBytes;
+
+    m_t0 = now_ns();
+    m_pid = (uint32_t)getpid();
+    m_tid = (uint32_t)syscall(SYS_gettid);
+}
+
+//---------------------------------------------------------------------------------------
+bool Instrumentation::writeChromeTrace(const char *_path) const
+{
+    FILE *fp = fopen(_path, "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const trace_event_t &e : m_events)
+    {
+        fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"kernel\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"pid\":%u,\"tid\":%u,\"args\":{\"bytes\":%llu,\"flops\":%llu}}",
+                first ? "" : ",\n", e.kernel->name,
+                (e.begin_ns - m_t0) * 1e-3, e.dur_ns * 1e-3, m_pid, m_tid,
+                (unsigned long long)e.bytes, (unsigned long long)e.flops);
+        first = false;
+    }
+    for (const residual_sample_t &r : m_residuals)
+    {
+        fprintf(fp, "%s{\"name\":\"residual/%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%u,"
+                    "\"args\":{\"residual\":%.9g,\"iteration\":%u}}",
+                first ? "" : ",\n", r.series, (r.ts_ns - m_t0) * 1e-3, m_pid, r.value, r.iteration);
+        first = false;
+    }
+    fprintf(fp, "\n],\"otherData\":{\"allocations\":%llu,\"frees\":%llu,\"alloc_bytes\":%llu,"
+                "\"live_bytes\":%llu,\"peak_live_bytes\":%llu,\"dropped_events\":%llu}}\n",
+            (unsigned long long)m_allocs, (unsigned long long)m_frees, (unsigned long long)m_allocBytes,
+            (unsigned long long)m_liveBytes, (unsigned long long)m_peakBytes, (unsigned long long)m_droppedEvents);
+
+    return fclose(fp) == 0;
+}
+
+//---------------------------------------------------------------------------------------
+bool Instrumentation::writeSummaryCsv(const char *_path) const
+{
+    FILE *fp = fopen(_path, "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "kernel,calls,total_ms,mean_us,min_us,max_us,bytes,flops,flop_per_byte,gflop_per_s,gbyte_per_s\n");
+    for (const kernel_stats_t *k : m_kernels)
+    {
+        if (!k->calls)
+            continue;
+        const double s = k->ns * 1e-9;
+        fprintf(fp, "%s,%llu,%.6f,%.3f,%.3f,%.3f,%llu,%llu,%.4f,%.4f,%.4f\n",
+                k->name, (unsigned long long)k->calls, k->ns * 1e-6, k->ns * 1e-3 / k->calls,
+                k->min_ns * 1e-3, k->max_ns * 1e-3,
+                (unsigned long long)k->bytes, (unsigned long long)k->flops,
+                k->bytes ? (double)k->flops / k->bytes : 0.0,
+                s > 0.0 ? k->flops / s * 1e-9 : 0.0,
+                s > 0.0 ? k->bytes / s * 1e-9 : 0.0);
+    }
+
+    return fclose(fp) == 0;
+}
+
+//---------------------------------------------------------------------------------------
+bool Instrumentation::writeResidualCsv(const char *_path) const
+{
+    FILE *fp = fopen(_path, "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "series,iteration,residual\n");
+    for (const residual_sample_t &r : m_residuals)
+        fprintf(fp, "%s,%u,%.9g\n", r.series, r.iteration, r.value);
+
+    return fclose(fp) == 0;
+}
+
+//---------------------------------------------------------------------------------------
+void Instrumentation::printSummary(FILE *_fp) const
+{
+    fprintf(_fp, "%-28s %10s %12s %12s %10s %10s %10s\n",
+            "kernel", "calls", "total[ms]", "mean[us]", "flop/B", "GFLOP/s", "GB/s");
+    for (const kernel_stats_t *k : m_kernels)
+    {
+        if (!k->calls)
+            continue;
+        const double s = k->ns * 1e-9;
+        fprintf(_fp, "%-28s %10llu %12.3f %12.3f %10.3f %10.2f %10.2f\n",
+                k->name, (unsigned long long)k->calls, k->ns * 1e-6, k->ns * 1e-3 / k->calls,
+                k->bytes ? (double)k->flops / k->bytes : 0.0,
+                s > 0.0 ? k->flops / s * 1e-9 : 0.0,
+                s > 0.0 ? k->bytes / s * 1e-9 : 0.0);
+    }
+    fprintf(_fp, "allocations: %llu (%.2f MB), frees: %llu, peak live: %.2f MB\n",
+            (unsigned long long)m_allocs, m_allocBytes / (1024.0 * 1024.0),
+            (unsigned long long)m_frees, m_peakBytes / (1024.0 * 1024.0));
+    if (m_droppedEvents)
+        fprintf(_fp, "trace buffer full, %llu events dropped\n", (unsigned long long)m_droppedEvents);
+}
+
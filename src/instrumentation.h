@@ -0,0 +1,186 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+
+// Hot-path instrumentation of the field / solver kernels, independent of the
+// Synapse profiler. Compiled in with FIELD_INSTRUMENTATION (premake --instrument),
+// otherwise every macro expands to nothing.
+//
+//  INSTR_KERNEL(name, bytes, flops)    time the enclosing scope as one kernel call
+//                                      moving `bytes` and performing `flops`
+//  INSTR_SCOPE(name)                   time the enclosing scope (no traffic)
+//  INSTR_RESIDUAL(series, iter, r)     append to a residual history
+//  INSTR_ALLOC(bytes) / INSTR_FREE(bytes)
+//
+// Names and series must be string literals. Not thread-safe: every process
+// (e.g. every rank of a decomposed run) records into its own instance.
+//
+#ifdef FIELD_INSTRUMENTATION
+    #define INSTR_CONCAT_(a, b) a##b
+    #define INSTR_CONCAT(a, b) INSTR_CONCAT_(a, b)
+    #define INSTR_KERNEL(name, bytes, flops) \
+        static kernel_stats_t *INSTR_CONCAT(__instr_stats_, __LINE__) = Instrumentation::get().kernel(name); \
+        KernelTimer INSTR_CONCAT(__instr_timer_, __LINE__)(INSTR_CONCAT(__instr_stats_, __LINE__), (bytes), (flops))
+    #define INSTR_SCOPE(name) INSTR_KERNEL(name, 0, 0)
+    #define INSTR_RESIDUAL(series, iter, r) Instrumentation::get().residual(series, iter, r)
+    #define INSTR_ALLOC(bytes) Instrumentation::get().alloc(bytes)
+    #define INSTR_FREE(bytes) Instrumentation::get().free(bytes)
+#else
+    #define INSTR_KERNEL(name, bytes, flops)
+    #define INSTR_SCOPE(name)
+    #define INSTR_RESIDUAL(series, iter, r)
+    #define INSTR_ALLOC(bytes)
+    #define INSTR_FREE(bytes)
+#endif
+
+
+//
+struct kernel_stats_t
+{
+    const char *name;
+    uint64_t calls      = 0;
+    uint64_t ns         = 0;
+    uint64_t bytes      = 0;
+    uint64_t flops      = 0;
+    uint64_t min_ns     = UINT64_MAX;
+    uint64_t max_ns     = 0;
+};
+
+//
+struct trace_event_t
+{
+    const kernel_stats_t *kernel;
+    uint64_t begin_ns;
+    uint64_t dur_ns;
+    uint64_t bytes;
+    uint64_t flops;
+};
+
+//
+struct residual_sample_t
+{
+    const char *series;
+    uint32_t iteration;
+    float value;
+    uint64_t ts_ns;
+};
+
+
+//
+class Instrumentation
+{
+public:
+    static Instrumentation &get() { static Instrumentation instance; return instance; }
+
+    //
+    static __always_inline uint64_t now_ns()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    // Stats slot for a kernel name, created on first use.
+    kernel_stats_t *kernel(const char *_name);
+
+    //
+    __always_inline void record(kernel_stats_t *_k, uint64_t _begin, uint64_t _end, uint64_t _bytes, uint64_t _flops)
+    {
+        const uint64_t dur = _end - _begin;
+        _k->calls++;
+        _k->ns += dur;
+        _k->bytes += _bytes;
+        _k->flops += _flops;
+        _k->min_ns = dur < _k->min_ns ? dur : _k->min_ns;
+        _k->max_ns = dur > _k->max_ns ? dur : _k->max_ns;
+
+        if (m_events.size() < m_maxEvents)
+            m_events.push_back({ _k, _begin, dur, _bytes, _flops });
+        else
+            m_droppedEvents++;
+    }
+
+    //
+    void residual(const char *_series, uint32_t _iteration, float _value)
+    {
+        m_residuals.push_back({ _series, _iteration, _value, now_ns() });
+    }
+
+    //
+    void alloc(uint64_t _bytes)
+    {
+        m_allocs++;
+        m_allocBytes += _bytes;
+        m_liveBytes += _bytes;
+        m_peakBytes = m_liveBytes > m_peakBytes ? m_liveBytes : m_peakBytes;
+    }
+    void free(uint64_t _bytes) { m_frees++; m_liveBytes -= _bytes; }
+
+    // Drops everything recorded so far, e.g. in a freshly forked rank.
+    void reset();
+
+    // Caps the trace buffer; kernel totals are kept regardless.
+    void setMaxEvents(size_t _n) { m_maxEvents = _n; }
+
+    // Chrome trace (chrome://tracing, Perfetto): kernels as complete events,
+    // residuals as counters, allocation totals and dropped events in otherData.
+    bool writeChromeTrace(const char *_path) const;
+
+    // One row per kernel, including arithmetic intensity (flop / byte) and the
+    // achieved GFLOP/s and GB/s for placing it on a roofline.
+    bool writeSummaryCsv(const char *_path) const;
+
+    // series, iteration, residual
+    bool writeResidualCsv(const char *_path) const;
+
+    //
+    void printSummary(FILE *_fp=stdout) const;
+
+
+private:
+    Instrumentation();
+
+private:
+    uint64_t m_t0 = 0;
+    uint32_t m_pid = 0;
+    uint32_t m_tid = 0;
+
+    std::vector<kernel_stats_t *> m_kernels;
+    std::vector<trace_event_t> m_events;
+    size_t m_maxEvents = 1 << 20;
+    uint64_t m_droppedEvents = 0;
+
+    std::vector<residual_sample_t> m_residuals;
+
+    uint64_t m_allocs = 0;
+    uint64_t m_frees = 0;
+    uint64_t m_allocBytes = 0;
+    uint64_t m_liveBytes = 0;
+    uint64_t m_peakBytes = 0;
+
+};
+
+
+//
+class KernelTimer
+{
+public:
+    __always_inline KernelTimer(kernel_stats_t *_k, uint64_t _bytes, uint64_t _flops) :
+        m_kernel(_k), m_bytes(_bytes), m_flops(_flops), m_begin(Instrumentation::now_ns()) {}
+    __always_inline ~KernelTimer()
+    {
+        Instrumentation::get().record(m_kernel, m_begin, Instrumentation::now_ns(), m_bytes, m_flops);
+    }
+
+private:
+    kernel_stats_t *m_kernel;
+    uint64_t m_bytes;
+    uint64_t m_flops;
+    uint64_t m_begin;
+
+};
+
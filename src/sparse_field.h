@@ -0,0 +1,792 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <glm/glm.hpp>
+
+#include "field.h"
+#include "instrumentation.h"
+
+// Bricks are the unit of allocation; BRICK_DIM x BRICK_DIM cells each.
+#define BRICK_DIM       16
+#define BRICK_CELLS     (BRICK_DIM * BRICK_DIM)
+// gathered brick + one cell halo on each side
+#define TILE_DIM        (BRICK_DIM + 2)
+#define TILE_CELLS      (TILE_DIM * TILE_DIM)
+//
+#define BRICK_NONE      -1
+#define NODE_NONE       -1
+
+
+// Magnitude used for refinement criteria.
+inline float field_mag(float _v) { return fabsf(_v); }
+inline float field_mag(const glm::vec2 &_v) { return glm::length(_v); }
+// Component-wise bounds used when building the quadtree.
+inline float field_min(float _a, float _b) { return fminf(_a, _b); }
+inline float field_max(float _a, float _b) { return fmaxf(_a, _b); }
+inline glm::vec2 field_min(const glm::vec2 &_a, const glm::vec2 &_b) { return { fminf(_a.x, _b.x), fminf(_a.y, _b.y) }; }
+inline glm::vec2 field_max(const glm::vec2 &_a, const glm::vec2 &_b) { return { fmaxf(_a.x, _b.x), fmaxf(_a.y, _b.y) }; }
+
+//
+template<typename T>
+struct brick_t
+{
+    T buffers[2][BRICK_CELLS];
+    glm::ivec2 id;          // brick coordinates, in bricks
+    int32_t slot;           // position in the active list
+    uint8_t front = 0;
+
+    T *data() { return buffers[front]; }
+    T *backBuffer() { return buffers[front ^ 1]; }
+    const T *data() const { return buffers[front]; }
+};
+
+// Quadtree over brick coordinates. Leaves larger than one brick are quiescent
+// regions represented by a single value; leaves of size 1 may own a brick.
+template<typename T>
+struct quadtree_node_t
+{
+    glm::ivec2 origin;      // in bricks
+    int32_t size;           // edge length in bricks (power of two)
+    int32_t parent = NODE_NONE;
+    int32_t child = NODE_NONE;  // first of four consecutive children
+    T value;
+    float error = 0.0f;     // bound on |cell - value| over the region (leaves)
+};
+
+
+//
+template<typename T>
+class SparseField
+{
+public:
+
+    //
+    SparseField() {}
+    SparseField(const glm::ivec2 &_shape, const T &_background=T(0)) { new_(_shape, _background); }
+    SparseField(const SparseField &) = delete;
+    SparseField &operator=(const SparseField &) = delete;
+    ~SparseField() { clear_(); }
+
+    // Rebuilds the field from a sampling function, evaluated once per cell. A
+    // brick is allocated where its cells deviate from their midrange value by
+    // more than _threshold; quiescent bricks collapse into quadtree leaves as long
+    // as every cell stays within _threshold of the leaf value. Bricks that
+    // updateActivity() would grow into are then allocated too, so that it is a
+    // no-op on the unchanged result.
+    void refine(const std::function<T(int, int)> &_sample, float _threshold)
+    {
+        assert(!m_nodes.empty() && "field has no shape");
+        if (m_nodes.empty())
+            return;
+
+        const T background = m_nodes[0].value;
+        clear_();
+        m_nodes.push_back(root_(background));
+        build_node_(0, _sample, _threshold);
+
+        std::vector<glm::ivec2> to_activate;
+        do
+        {
+            to_activate.clear();
+            collect_growth_(_threshold, to_activate);
+            for (auto &id : to_activate)
+            {
+                if (page(id) != BRICK_NONE)
+                    continue;
+                const glm::ivec2 ext = extent(id);
+                T *p = m_bricks[activate(id)]->data();
+                for (int ly = 0; ly < ext.y; ly++)
+                    for (int lx = 0; lx < ext.x; lx++)
+                        p[ly * BRICK_DIM + lx] = _sample(id.x * BRICK_DIM + lx, id.y * BRICK_DIM + ly);
+            }
+        } while (!to_activate.empty());
+    }
+
+    //
+    void fromDense(Field<T> *_f, float _threshold)
+    {
+        assert(_f->size() == (uint32_t)(m_shape.x * m_shape.y));
+        T *p = _f->data();
+        const int nx = m_shape.x;
+        refine([p, nx](int _x, int _y) { return p[_y * nx + _x]; }, _threshold);
+    }
+
+    //
+    void toDense(Field<T> *_f) const
+    {
+        assert(_f->size() == (uint32_t)(m_shape.x * m_shape.y));
+        T *p = _f->data();
+        for (int y = 0; y < m_shape.y; y++)
+            for (int x = 0; x < m_shape.x; x++)
+                p[y * m_shape.x + x] = get(x, y);
+    }
+
+    // Releases bricks whose cells are within _threshold of their midrange and
+    // that no active neighbour requires (see required_()), if _release is set,
+    // then grows the active set until no inactive brick is required. The leaf of
+    // every active brick first takes the brick's current midrange, so bricks
+    // are measured against what they hold now rather than against the value
+    // they were refined from, and released leaves merge with siblings that
+    // agree within _threshold. Both phases run to a fixed point, so calling it
+    // twice on an unchanged field changes nothing the second time.
+    void updateActivity(float _threshold, bool _release=true)
+    {
+        for (int32_t idx : m_active)
+        {
+            const brick_t<T> *b = m_bricks[idx];
+            const glm::ivec2 ext = extent(b->id);
+            const T *p = b->data();
+
+            T lo = p[0];
+            T hi = p[0];
+            for (int ly = 0; ly < ext.y; ly++)
+            {
+                for (int lx = 0; lx < ext.x; lx++)
+                {
+                    lo = field_min(lo, p[ly * BRICK_DIM + lx]);
+                    hi = field_max(hi, p[ly * BRICK_DIM + lx]);
+                }
+            }
+            quadtree_node_t<T> &leaf = m_nodes[leaf_(b->id)];
+            leaf.value = (lo + hi) * 0.5f;
+            leaf.error = field_mag(hi - lo) * 0.5f;
+        }
+
+        std::vector<glm::ivec2> ids;
+        while (_release)
+        {
+            // a release can free a brick that only the released one required
+            ids.clear();
+            for (int32_t idx : m_active)
+            {
+                const glm::ivec2 id = m_bricks[idx]->id;
+                if (m_nodes[leaf_(id)].error <= _threshold && !required_(id, _threshold))
+                    ids.push_back(id);
+            }
+            if (ids.empty())
+                break;
+            for (auto &id : ids)
+                deactivate(id, _threshold);
+        }
+
+        do
+        {
+            ids.clear();
+            collect_growth_(_threshold, ids);
+            for (auto &id : ids)
+                activate(id);
+        } while (!ids.empty());
+    }
+
+    // Allocates the brick at _id (filled with the background value) if needed,
+    // returns its index.
+    int32_t activate(const glm::ivec2 &_id)
+    {
+        assert(inDomain_(_id));
+        int32_t &entry = m_pageTable[_id.y * m_bricksShape.x + _id.x];
+        if (entry != BRICK_NONE)
+            return entry;
+
+        // refine down to a single brick leaf
+        int32_t node = leaf_(_id);
+        while (m_nodes[node].size > 1)
+        {
+            split_(node);
+            node = child_containing_(node, _id);
+        }
+
+        brick_t<T> *b = new brick_t<T>;
+        INSTR_ALLOC(sizeof(brick_t<T>));
+        b->id = _id;
+        b->slot = (int32_t)m_active.size();
+        const T bg = m_nodes[node].value;
+        for (uint32_t i = 0; i < BRICK_CELLS; i++)
+            b->buffers[0][i] = b->buffers[1][i] = bg;
+
+        int32_t idx;
+        if (!m_freeBricks.empty()) { idx = m_freeBricks.back(); m_freeBricks.pop_back(); m_bricks[idx] = b; }
+        else                       { idx = (int32_t)m_bricks.size(); m_bricks.push_back(b); }
+
+        m_active.push_back(idx);
+        entry = idx;
+        return idx;
+    }
+
+    // Releases the brick at _id; its cells revert to the quadtree background.
+    // Empty sibling leaves are merged as long as the merged value stays within
+    // _tolerance of every cell they represent (see coarsen_()).
+    void deactivate(const glm::ivec2 &_id, float _tolerance=0.0f)
+    {
+        int32_t &entry = m_pageTable[_id.y * m_bricksShape.x + _id.x];
+        if (entry == BRICK_NONE)
+            return;
+
+        brick_t<T> *b = m_bricks[entry];
+        // swap-remove from the active list
+        int32_t last = m_active.back();
+        m_active[b->slot] = last;
+        m_bricks[last]->slot = b->slot;
+        m_active.pop_back();
+
+        delete b;
+        INSTR_FREE(sizeof(brick_t<T>));
+        m_bricks[entry] = nullptr;
+        m_freeBricks.push_back(entry);
+        entry = BRICK_NONE;
+
+        coarsen_(m_nodes[leaf_(_id)].parent, _tolerance);
+    }
+
+    // Makes the active set of this field equal to that of _src.
+    template<typename U>
+    void matchActivity(const SparseField<U> &_src)
+    {
+        assert(_src.shape() == m_shape);
+        std::vector<glm::ivec2> to_release;
+        for (int32_t idx : m_active)
+            if (_src.page(m_bricks[idx]->id) == BRICK_NONE)
+                to_release.push_back(m_bricks[idx]->id);
+        for (auto &id : to_release)
+            deactivate(id);
+        for (int32_t idx : _src.activeBricks())
+            activate(_src.brick(idx)->id);
+    }
+
+    // Adds the active set of _src to this field's.
+    template<typename U>
+    void unionActivity(const SparseField<U> &_src)
+    {
+        for (int32_t idx : _src.activeBricks())
+            activate(_src.brick(idx)->id);
+    }
+
+    //
+    T get(int _x, int _y) const
+    {
+        const glm::ivec2 id = { _x / BRICK_DIM, _y / BRICK_DIM };
+        const int32_t idx = page(id);
+        if (idx != BRICK_NONE)
+            return m_bricks[idx]->data()[(_y % BRICK_DIM) * BRICK_DIM + (_x % BRICK_DIM)];
+        return m_nodes[leaf_(id)].value;
+    }
+
+    //
+    void set(int _x, int _y, const T &_val)
+    {
+        const int32_t idx = activate({ _x / BRICK_DIM, _y / BRICK_DIM });
+        m_bricks[idx]->data()[(_y % BRICK_DIM) * BRICK_DIM + (_x % BRICK_DIM)] = _val;
+    }
+
+    // Copies brick _idx plus a one-cell halo into _tile (TILE_DIM x TILE_DIM,
+    // brick cell (lx, ly) at (lx+1, ly+1)). Halo cells come from neighbouring
+    // bricks when allocated and from the quadtree background otherwise; at the
+    // domain boundary the edge is replicated (zero gradient). Corners are unset.
+    void gatherTile(int32_t _idx, T *_tile) const
+    {
+        const brick_t<T> *b = m_bricks[_idx];
+        const glm::ivec2 ext = extent(b->id);
+        const T *src = b->data();
+
+        for (int ly = 0; ly < ext.y; ly++)
+            memcpy(&_tile[(ly + 1) * TILE_DIM + 1], &src[ly * BRICK_DIM], ext.x * sizeof(T));
+
+        // left / right
+        gather_edge_(_tile, b->id, { -1, 0 }, ext.y, 0,                       BRICK_DIM - 1,                TILE_DIM,                   BRICK_DIM, TILE_DIM);
+        gather_edge_(_tile, b->id, {  1, 0 }, ext.y, ext.x - 1,               0,                            TILE_DIM + ext.x + 1,       BRICK_DIM, TILE_DIM);
+        // bottom / top
+        gather_edge_(_tile, b->id, { 0, -1 }, ext.x, 0,                       (BRICK_DIM - 1) * BRICK_DIM,  1,                          1,         1);
+        gather_edge_(_tile, b->id, { 0,  1 }, ext.x, (ext.y - 1) * BRICK_DIM, 0,                            (ext.y + 1) * TILE_DIM + 1, 1,         1);
+    }
+
+    //
+    void swap()
+    {
+        for (int32_t idx : m_active)
+            m_bricks[idx]->front ^= 1;
+    }
+
+    // Number of valid cells in brick _id along x and y (partial at the far edges).
+    glm::ivec2 extent(const glm::ivec2 &_id) const
+    {
+        return { std::min(BRICK_DIM, m_shape.x - _id.x * BRICK_DIM),
+                 std::min(BRICK_DIM, m_shape.y - _id.y * BRICK_DIM) };
+    }
+
+    //
+    int32_t page(const glm::ivec2 &_id) const { return m_pageTable[_id.y * m_bricksShape.x + _id.x]; }
+    brick_t<T> *brick(int32_t _idx) { return m_bricks[_idx]; }
+    const brick_t<T> *brick(int32_t _idx) const { return m_bricks[_idx]; }
+    const std::vector<int32_t> &activeBricks() const { return m_active; }
+    T background(const glm::ivec2 &_id) const { return m_nodes[leaf_(_id)].value; }
+
+    //
+    const glm::ivec2 &shape() const { return m_shape; }
+    const glm::ivec2 &bricksShape() const { return m_bricksShape; }
+    uint32_t activeBrickCount() const { return (uint32_t)m_active.size(); }
+    uint32_t nodeCount() const { return (uint32_t)(m_nodes.size() - m_freeNodes.size() * 4); }
+    size_t size_bytes() const
+    {
+        return m_active.size() * sizeof(brick_t<T>) +
+               m_pageTable.size() * sizeof(int32_t) +
+               m_nodes.size() * sizeof(quadtree_node_t<T>);
+    }
+
+
+private:
+    void new_(const glm::ivec2 &_shape, const T &_background)
+    {
+        m_shape = _shape;
+        m_bricksShape = { (_shape.x + BRICK_DIM - 1) / BRICK_DIM, (_shape.y + BRICK_DIM - 1) / BRICK_DIM };
+        m_pageTable.assign(m_bricksShape.x * m_bricksShape.y, BRICK_NONE);
+        m_nodes.push_back(root_(_background));
+    }
+
+    //
+    void clear_()
+    {
+        for (auto *b : m_bricks)
+        {
+            if (!b) continue;
+            delete b;
+            INSTR_FREE(sizeof(brick_t<T>));
+        }
+        m_bricks.clear();
+        m_freeBricks.clear();
+        m_active.clear();
+        m_nodes.clear();
+        m_freeNodes.clear();
+        std::fill(m_pageTable.begin(), m_pageTable.end(), BRICK_NONE);
+    }
+
+    //
+    quadtree_node_t<T> root_(const T &_value) const
+    {
+        int32_t sz = 1;
+        while (sz < m_bricksShape.x || sz < m_bricksShape.y)
+            sz <<= 1;
+        quadtree_node_t<T> root;
+        root.origin = { 0, 0 };
+        root.size = sz;
+        root.value = _value;
+        return root;
+    }
+
+    //
+    bool inDomain_(const glm::ivec2 &_id) const
+    {
+        return _id.x >= 0 && _id.y >= 0 && _id.x < m_bricksShape.x && _id.y < m_bricksShape.y;
+    }
+
+    //
+    int32_t child_containing_(int32_t _node, const glm::ivec2 &_id) const
+    {
+        const quadtree_node_t<T> &n = m_nodes[_node];
+        const int32_t half = n.size >> 1;
+        const int q = (_id.x >= n.origin.x + half ? 1 : 0) + (_id.y >= n.origin.y + half ? 2 : 0);
+        return n.child + q;
+    }
+
+    //
+    int32_t leaf_(const glm::ivec2 &_id) const
+    {
+        int32_t node = 0;
+        while (m_nodes[node].child != NODE_NONE)
+            node = child_containing_(node, _id);
+        return node;
+    }
+
+    // Splits a leaf into four children inheriting its value.
+    void split_(int32_t _node)
+    {
+        int32_t first;
+        if (!m_freeNodes.empty()) { first = m_freeNodes.back(); m_freeNodes.pop_back(); }
+        else                      { first = (int32_t)m_nodes.size(); m_nodes.resize(m_nodes.size() + 4); }
+
+        const quadtree_node_t<T> n = m_nodes[_node];
+        const int32_t half = n.size >> 1;
+        for (int q = 0; q < 4; q++)
+        {
+            quadtree_node_t<T> &c = m_nodes[first + q];
+            c.origin = n.origin + glm::ivec2((q & 1) * half, (q >> 1) * half);
+            c.size = half;
+            c.parent = _node;
+            c.child = NODE_NONE;
+            c.value = n.value;
+            c.error = n.error;
+        }
+        m_nodes[_node].child = first;
+    }
+
+    // Merges four brickless leaves with equal values back into their parent,
+    // walking up the tree while possible.
+    // Merges the four leaves under _node (and so on upwards) when none of them
+    // owns a brick and the merged value, their midrange, is within _tolerance of
+    // every cell, or no further off than the children already are. Children
+    // outside the domain are ignored.
+    void coarsen_(int32_t _node, float _tolerance)
+    {
+        while (_node != NODE_NONE)
+        {
+            const int32_t first = m_nodes[_node].child;
+            bool empty = true;
+            T lo = T(0), hi = T(0);
+            float child_error = 0.0f;
+            for (int q = 0; q < 4; q++)
+            {
+                const quadtree_node_t<T> &c = m_nodes[first + q];
+                if (c.origin.x >= m_bricksShape.x || c.origin.y >= m_bricksShape.y)
+                    continue;
+                if (c.child != NODE_NONE)
+                    return;
+                if (c.size == 1 && page(c.origin) != BRICK_NONE)
+                    return;
+                lo = (empty ? c.value : field_min(lo, c.value));
+                hi = (empty ? c.value : field_max(hi, c.value));
+                child_error = fmaxf(child_error, c.error);
+                empty = false;
+            }
+
+            const T mid = (lo + hi) * 0.5f;
+            float error = 0.0f;
+            for (int q = 0; q < 4; q++)
+            {
+                const quadtree_node_t<T> &c = m_nodes[first + q];
+                if (c.origin.x < m_bricksShape.x && c.origin.y < m_bricksShape.y)
+                    error = fmaxf(error, c.error + field_mag(c.value - mid));
+            }
+            if (error > fmaxf(_tolerance, child_error))
+                return;
+
+            m_nodes[_node].value = mid;
+            m_nodes[_node].error = error;
+            m_nodes[_node].child = NODE_NONE;
+            m_freeNodes.push_back(first);
+            _node = m_nodes[_node].parent;
+        }
+    }
+
+    // True if an active neighbour of brick _id has edge cells facing it that the
+    // leaf holding _id does not represent: |e - value| > _threshold + error, with
+    // error the leaf's own bound on its cells. A leaf that already carries an
+    // error up to _threshold is not grown into by edges it is consistent with.
+    bool required_(const glm::ivec2 &_id, float _threshold) const
+    {
+        static const glm::ivec2 dirs[4] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        const quadtree_node_t<T> &leaf = m_nodes[leaf_(_id)];
+        const T bg = leaf.value;
+        const float tol = _threshold + leaf.error;
+
+        for (int d = 0; d < 4; d++)
+        {
+            const glm::ivec2 nid = _id + dirs[d];
+            if (!inDomain_(nid))
+                continue;
+            const int32_t idx = page(nid);
+            if (idx == BRICK_NONE)
+                continue;
+
+            const T *p = m_bricks[idx]->data();
+            const glm::ivec2 ext = extent(nid);
+
+            // the neighbour's edge facing _id, and the stride along it
+            int first, stride, n;
+            switch (d)
+            {
+                case 0:  first = ext.x - 1;                 stride = BRICK_DIM; n = ext.y; break;
+                case 1:  first = 0;                         stride = BRICK_DIM; n = ext.y; break;
+                case 2:  first = (ext.y - 1) * BRICK_DIM;   stride = 1;         n = ext.x; break;
+                default: first = 0;                         stride = 1;         n = ext.x; break;
+            }
+            for (int i = 0; i < n; i++)
+                if (field_mag(p[first + i * stride] - bg) > tol)
+                    return true;
+        }
+        return false;
+    }
+
+    // Inactive bricks next to the active set that required_() asks for.
+    void collect_growth_(float _threshold, std::vector<glm::ivec2> &_out) const
+    {
+        static const glm::ivec2 dirs[4] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+        for (int32_t idx : m_active)
+        {
+            for (int d = 0; d < 4; d++)
+            {
+                const glm::ivec2 nid = m_bricks[idx]->id + dirs[d];
+                if (inDomain_(nid) && page(nid) == BRICK_NONE && required_(nid, _threshold))
+                    _out.push_back(nid);
+            }
+        }
+    }
+
+    // Bottom-up build used by refine(). Returns whether the subtree may collapse
+    // into a single leaf (no bricks, every cell within _threshold of the
+    // midrange) and the component-wise value range of its cells.
+    struct build_range_t
+    {
+        bool collapsible;
+        bool empty;
+        T lo;
+        T hi;
+    };
+
+    build_range_t build_node_(int32_t _node, const std::function<T(int, int)> &_sample, float _threshold)
+    {
+        const glm::ivec2 origin = m_nodes[_node].origin;
+        const int32_t size = m_nodes[_node].size;
+
+        if (origin.x >= m_bricksShape.x || origin.y >= m_bricksShape.y)
+            return { true, true, T(0), T(0) };  // entirely outside the domain
+
+        if (size == 1)
+        {
+            T tile[BRICK_CELLS];
+            const glm::ivec2 ext = extent(origin);
+            T lo = _sample(origin.x * BRICK_DIM, origin.y * BRICK_DIM);
+            T hi = lo;
+            for (int ly = 0; ly < ext.y; ly++)
+            {
+                for (int lx = 0; lx < ext.x; lx++)
+                {
+                    const T v = _sample(origin.x * BRICK_DIM + lx, origin.y * BRICK_DIM + ly);
+                    tile[ly * BRICK_DIM + lx] = v;
+                    lo = field_min(lo, v);
+                    hi = field_max(hi, v);
+                }
+            }
+            m_nodes[_node].value = (lo + hi) * 0.5f;
+            m_nodes[_node].error = field_mag(hi - lo) * 0.5f;
+
+            if (field_mag(hi - lo) * 0.5f <= _threshold)
+                return { true, false, lo, hi };
+
+            const int32_t idx = activate(origin);
+            T *p = m_bricks[idx]->data();
+            for (int ly = 0; ly < ext.y; ly++)
+                memcpy(&p[ly * BRICK_DIM], &tile[ly * BRICK_DIM], ext.x * sizeof(T));
+            return { false, false, lo, hi };
+        }
+
+        split_(_node);
+        const int32_t first = m_nodes[_node].child;
+        build_range_t r = { true, true, T(0), T(0) };
+        for (int q = 0; q < 4; q++)
+        {
+            const build_range_t c = build_node_(first + q, _sample, _threshold);
+            r.collapsible = r.collapsible && c.collapsible;
+            if (c.empty)
+                continue;
+            r.lo = (r.empty ? c.lo : field_min(r.lo, c.lo));
+            r.hi = (r.empty ? c.hi : field_max(r.hi, c.hi));
+            r.empty = false;
+        }
+        m_nodes[_node].value = (r.lo + r.hi) * 0.5f;
+        m_nodes[_node].error = field_mag(r.hi - r.lo) * 0.5f;
+
+        r.collapsible = r.collapsible && field_mag(r.hi - r.lo) * 0.5f <= _threshold;
+        if (r.collapsible)
+        {
+            // quiescent: a single leaf holding the midrange
+            m_nodes[_node].child = NODE_NONE;
+            m_freeNodes.push_back(first);
+        }
+        return r;
+    }
+
+    // Fills one halo edge of a gathered tile: _n cells written from _dst with
+    // stride _dst_stride, read with stride _src_stride from this brick at _own
+    // (domain boundary) or from the neighbour in direction _dir at _nb.
+    void gather_edge_(T *_tile, const glm::ivec2 &_id, const glm::ivec2 &_dir, int _n,
+                      int _own, int _nb, int _dst, int _src_stride, int _dst_stride) const
+    {
+        const glm::ivec2 nid = _id + _dir;
+        if (!inDomain_(nid))
+        {
+            const T *src = m_bricks[page(_id)]->data();
+            for (int i = 0; i < _n; i++)
+                _tile[_dst + i * _dst_stride] = src[_own + i * _src_stride];
+            return;
+        }
+
+        const int32_t idx = page(nid);
+        if (idx != BRICK_NONE)
+        {
+            const T *src = m_bricks[idx]->data();
+            for (int i = 0; i < _n; i++)
+                _tile[_dst + i * _dst_stride] = src[_nb + i * _src_stride];
+        }
+        else
+        {
+            const T bg = m_nodes[leaf_(nid)].value;
+            for (int i = 0; i < _n; i++)
+                _tile[_dst + i * _dst_stride] = bg;
+        }
+    }
+
+
+private:
+    glm::ivec2 m_shape          = { 0, 0 };
+    glm::ivec2 m_bricksShape    = { 0, 0 };
+
+    std::vector<brick_t<T> *> m_bricks;     // brick pool, nullptr for free slots
+    std::vector<int32_t> m_freeBricks;
+    std::vector<int32_t> m_active;          // indices into m_bricks
+    std::vector<int32_t> m_pageTable;       // brick coordinates -> index, or BRICK_NONE
+
+    std::vector<quadtree_node_t<T>> m_nodes;
+    std::vector<int32_t> m_freeNodes;       // first index of released child quads
+
+};
+
+using SparseField1D = SparseField<float>;
+using SparseField2D = SparseField<glm::vec2>;
+
+
+//---------------------------------------------------------------------------------------
+// Per-brick kernels. Inactive regions are treated as their quadtree background;
+// output fields take the active set of their input.
+//---------------------------------------------------------------------------------------
+
+// Central-difference gradient of a scalar field.
+inline void sparse_gradient(const SparseField1D &_f, SparseField2D &_grad, float _h)
+{
+    _grad.matchActivity(_f);
+    // per cell: read 1 float, write 1 vec2; 2 sub + 2 mul
+    INSTR_KERNEL("sparse_gradient", (uint64_t)_f.activeBrickCount() * BRICK_CELLS * 12, (uint64_t)_f.activeBrickCount() * BRICK_CELLS * 4);
+    const float inv_2h = 1.0f / (2.0f * _h);
+    float tile[TILE_CELLS];
+
+    for (int32_t idx : _f.activeBricks())
+    {
+        const glm::ivec2 id = _f.brick(idx)->id;
+        const glm::ivec2 ext = _f.extent(id);
+        _f.gatherTile(idx, tile);
+        glm::vec2 *g = _grad.brick(_grad.page(id))->data();
+
+        for (int ly = 0; ly < ext.y; ly++)
+        {
+            for (int lx = 0; lx < ext.x; lx++)
+            {
+                const int t = (ly + 1) * TILE_DIM + lx + 1;
+                g[ly * BRICK_DIM + lx] = { (tile[t + 1] - tile[t - 1]) * inv_2h,
+                                           (tile[t + TILE_DIM] - tile[t - TILE_DIM]) * inv_2h };
+            }
+        }
+    }
+}
+
+// Central-difference divergence of a vector field.
+inline void sparse_divergence(const SparseField2D &_v, SparseField1D &_div, float _h)
+{
+    _div.matchActivity(_v);
+    // per cell: read 1 vec2, write 1 float; 3 add/sub + 1 mul
+    INSTR_KERNEL("sparse_divergence", (uint64_t)_v.activeBrickCount() * BRICK_CELLS * 12, (uint64_t)_v.activeBrickCount() * BRICK_CELLS * 4);
+    const float inv_2h = 1.0f / (2.0f * _h);
+    glm::vec2 tile[TILE_CELLS];
+
+    for (int32_t idx : _v.activeBricks())
+    {
+        const glm::ivec2 id = _v.brick(idx)->id;
+        const glm::ivec2 ext = _v.extent(id);
+        _v.gatherTile(idx, tile);
+        float *d = _div.brick(_div.page(id))->data();
+
+        for (int ly = 0; ly < ext.y; ly++)
+        {
+            for (int lx = 0; lx < ext.x; lx++)
+            {
+                const int t = (ly + 1) * TILE_DIM + lx + 1;
+                d[ly * BRICK_DIM + lx] = inv_2h * (tile[t + 1].x - tile[t - 1].x +
+                                                   tile[t + TILE_DIM].y - tile[t - TILE_DIM].y);
+            }
+        }
+    }
+}
+
+// One Jacobi sweep of the pressure Poisson equation lap(p) = div. The active set
+// of _p first grows to cover _div and, with _grow_threshold > 0, into bricks
+// its own edges require (see SparseField::updateActivity()). Where _p is
+// inactive it is pinned to its background, which acts as a Dirichlet condition
+// on the edge of the active set: the result only solves the Poisson problem on
+// the whole domain if _p has grown to cover the solution to within the
+// threshold, or is fully active.
+inline void sparse_jacobi(SparseField1D &_p, const SparseField1D &_div, float _h, float _grow_threshold)
+{
+    if (_grow_threshold > 0.0f)
+        _p.updateActivity(_grow_threshold, false);
+    _p.unionActivity(_div);
+    // per cell: read p and div, write p; 4 add/sub + 2 mul
+    INSTR_KERNEL("sparse_jacobi", (uint64_t)_p.activeBrickCount() * BRICK_CELLS * 12, (uint64_t)_p.activeBrickCount() * BRICK_CELLS * 6);
+    const float h2 = _h * _h;
+    float tile[TILE_CELLS];
+
+    for (int32_t idx : _p.activeBricks())
+    {
+        brick_t<float> *b = _p.brick(idx);
+        const glm::ivec2 ext = _p.extent(b->id);
+        _p.gatherTile(idx, tile);
+        float *out = b->backBuffer();
+
+        const int32_t didx = _div.page(b->id);
+        const float *d = (didx != BRICK_NONE ? _div.brick(didx)->data() : nullptr);
+        const float d_bg = _div.background(b->id);
+
+        for (int ly = 0; ly < ext.y; ly++)
+        {
+            for (int lx = 0; lx < ext.x; lx++)
+            {
+                const int t = (ly + 1) * TILE_DIM + lx + 1;
+                const float rhs = (d ? d[ly * BRICK_DIM + lx] : d_bg);
+                out[ly * BRICK_DIM + lx] = 0.25f * (tile[t - 1] + tile[t + 1] +
+                                                    tile[t - TILE_DIM] + tile[t + TILE_DIM] -
+                                                    h2 * rhs);
+            }
+        }
+    }
+    _p.swap();
+}
+
+// L2 norm of the Poisson residual lap(p) - div over the union of the active sets
+// of _p and _div (_p grows to cover _div, as in sparse_jacobi()). Elsewhere both
+// are at their backgrounds and are not summed.
+inline float sparse_residual(SparseField1D &_p, const SparseField1D &_div, float _h)
+{
+    _p.unionActivity(_div);
+    // per cell: read p and div; 6 add/sub + 3 mul
+    INSTR_KERNEL("sparse_residual", (uint64_t)_p.activeBrickCount() * BRICK_CELLS * 8, (uint64_t)_p.activeBrickCount() * BRICK_CELLS * 9);
+    const float inv_h2 = 1.0f / (_h * _h);
+    float tile[TILE_CELLS];
+    double sum = 0.0;
+
+    for (int32_t idx : _p.activeBricks())
+    {
+        const brick_t<float> *b = _p.brick(idx);
+        const glm::ivec2 ext = _p.extent(b->id);
+        _p.gatherTile(idx, tile);
+
+        const int32_t didx = _div.page(b->id);
+        const float *d = (didx != BRICK_NONE ? _div.brick(didx)->data() : nullptr);
+        const float d_bg = _div.background(b->id);
+
+        for (int ly = 0; ly < ext.y; ly++)
+        {
+            for (int lx = 0; lx < ext.x; lx++)
+            {
+                const int t = (ly + 1) * TILE_DIM + lx + 1;
+                const float lap = inv_h2 * (tile[t - 1] + tile[t + 1] + tile[t - TILE_DIM] +
+                                            tile[t + TILE_DIM] - 4.0f * tile[t]);
+                const float r = lap - (d ? d[ly * BRICK_DIM + lx] : d_bg);
+                sum += (double)r * r;
+            }
+        }
+    }
+    return (float)sqrt(sum);
+}
+